@@ -0,0 +1,214 @@
+/* tag: host stand-in for the PalmOS SDK headers
+ * arch-tag: host stand-in for the PalmOS SDK headers
+ *
+ * PalmHTTP - an HTTP library for Palm devices
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/*
+ * Just enough of the PalmOS API for http.c, xmlrpc.c and netsim.c to build
+ * and run on the desktop, so the parser and the HTTP state machine can be
+ * timed and fuzzed there.  vagablog.c is all UI and isn't built this way.
+ * The calls are implemented in palmos.c.  Stream DBs are kept in memory,
+ * VFS paths are host files and the network calls always fail, so requests
+ * have to go through the netsim transport.
+ */
+
+#if !defined(HOST_PALMOS_H_)
+#define HOST_PALMOS_H_ 1
+
+#include <stddef.h>
+
+
+/*
+ * Basic types, sized as on the device
+ */
+
+typedef unsigned char UInt8;
+typedef signed char Int8;
+typedef unsigned short UInt16;
+typedef signed short Int16;
+typedef unsigned int UInt32;
+typedef signed int Int32;
+typedef unsigned char Boolean;
+typedef char Char;
+typedef UInt16 Err;
+typedef void *MemPtr;
+typedef UInt32 LocalID;
+
+#define true (1)
+#define false (0)
+#define errNone (0)
+
+
+/*
+ * Memory
+ */
+
+typedef struct HostHandle_struct *MemHandle;
+
+MemPtr MemPtrNew( UInt32 size );
+Err MemPtrFree( MemPtr ptr );
+MemPtr MemHandleLock( MemHandle handle );
+Err MemHandleUnlock( MemHandle handle );
+UInt32 MemHandleSize( MemHandle handle );
+Err MemSet( void *dest, Int32 length, UInt8 value );
+Err MemMove( void *dest, const void *src, Int32 length );
+Int16 MemCmp( const void *a, const void *b, Int32 length );
+
+
+/*
+ * Strings
+ */
+
+#define maxStrIToALen (12)
+
+Int16 StrLen( const Char *str );
+Char *StrCopy( Char *dest, const Char *src );
+Char *StrNCopy( Char *dest, const Char *src, Int16 length );
+Int16 StrCompare( const Char *a, const Char *b );
+Int16 StrCaselessCompare( const Char *a, const Char *b );
+Int16 StrNCaselessCompare( const Char *a, const Char *b, Int32 length );
+Int32 StrAToI( const Char *str );
+Char *StrIToA( Char *dest, Int32 value );
+Int16 StrPrintF( Char *dest, const Char *format, ... );
+Boolean TxtCharIsSpace( Char ch );
+
+
+/*
+ * Databases
+ */
+
+typedef struct HostDB_struct *DmOpenRef;
+
+#define dmModeReadOnly (0x0001)
+#define dmModeReadWrite (0x0003)
+#define dmMaxRecordIndex (0xffff)
+
+DmOpenRef DmOpenDatabaseByTypeCreator( UInt32 type, UInt32 creator,
+                                       UInt16 mode );
+Err DmCreateDatabase( UInt16 cardNo, const Char *name, UInt32 creator,
+                      UInt32 type, Boolean resDB );
+Err DmCloseDatabase( DmOpenRef db );
+UInt16 DmNumRecords( DmOpenRef db );
+MemHandle DmQueryRecord( DmOpenRef db, UInt16 index );
+MemHandle DmGetRecord( DmOpenRef db, UInt16 index );
+MemHandle DmNewRecord( DmOpenRef db, UInt16 *index, UInt32 size );
+Err DmReleaseRecord( DmOpenRef db, UInt16 index, Boolean dirty );
+Err DmRemoveRecord( DmOpenRef db, UInt16 index );
+Err DmWrite( void *record, UInt32 offset, const void *src, UInt32 length );
+
+
+/*
+ * File streams
+ */
+
+typedef struct HostStream_struct *FileHand;
+
+#define fileModeReadOnly (0x80000000UL)
+#define fileModeReadWrite (0x40000000UL)
+
+FileHand FileOpen( UInt16 cardNo, const Char *name, UInt32 type,
+                   UInt32 creator, UInt32 openMode, Err *err );
+Err FileClose( FileHand stream );
+Int32 FileRead( FileHand stream, void *buffer, Int32 objSize,
+                Int32 numObj, Err *err );
+Int32 FileWrite( FileHand stream, const void *data, Int32 objSize,
+                 Int32 numObj, Err *err );
+Int32 FileTell( FileHand stream, Int32 *size, Err *err );
+
+
+/*
+ * VFS, where a path is a host file and the volume is ignored
+ */
+
+typedef UInt32 FileRef;
+
+#define vfsModeRead (0x0002)
+#define vfsErrFileEOF (0x2A07)
+
+Err VFSFileOpen( UInt16 volRef, const Char *path, UInt16 openMode,
+                 FileRef *file );
+Err VFSFileClose( FileRef file );
+Err VFSFileRead( FileRef file, UInt32 length, void *buffer,
+                 UInt32 *read );
+Err VFSFileSize( FileRef file, UInt32 *size );
+
+
+/*
+ * Time
+ */
+
+typedef struct DateTimeType_struct {
+    Int16 second;
+    Int16 minute;
+    Int16 hour;
+    Int16 day;
+    Int16 month;
+    Int16 year;
+    Int16 weekDay;
+} DateTimeType;
+
+UInt16 SysTicksPerSecond( void );
+UInt32 TimGetTicks( void );
+UInt32 TimGetSeconds( void );
+
+
+/*
+ * Network library, which is never up on the host
+ */
+
+typedef Int16 NetSocketRef;
+
+#define netErrAlreadyOpen (0x1201)
+#define netSocketOptLevelTCP (6)
+#define netSocketOptTCPNoDelay (1)
+
+extern UInt16 AppNetRefnum;
+extern Int32 AppNetTimeout;
+
+Err SysLibFind( const Char *name, UInt16 *refNum );
+Err NetLibOpen( UInt16 refNum, UInt16 *ifErr );
+Err NetLibClose( UInt16 refNum, UInt16 immediate );
+Err NetLibConnectionRefresh( UInt16 refNum, Boolean refresh, UInt8 *allUp,
+                             UInt16 *netIFErr );
+Int16 NetLibSocketOptionSet( UInt16 refNum, NetSocketRef socket,
+                             UInt16 level, UInt16 option, void *value,
+                             UInt16 length, Int32 timeout, Err *err );
+NetSocketRef NetUTCPOpen( const Char *host, const Char *service,
+                          Int16 port );
+Int16 NetLibSend( UInt16 refNum, NetSocketRef socket, const void *data,
+                  UInt16 length, UInt16 flags, void *to, UInt16 toLength,
+                  Int32 timeout, Err *err );
+Int16 NetLibReceive( UInt16 refNum, NetSocketRef socket, void *buffer,
+                     UInt16 length, UInt16 flags, void *from,
+                     UInt16 *fromLength, Int32 timeout, Err *err );
+Int16 NetLibSocketClose( UInt16 refNum, NetSocketRef socket,
+                         Int32 timeout, Err *err );
+
+
+#endif /* HOST_PALMOS_H_ */
@@ -0,0 +1,53 @@
+/* tag: host stand-in for the PalmOS Berkeley socket glue
+ * arch-tag: host stand-in for the PalmOS Berkeley socket glue
+ *
+ * PalmHTTP - an HTTP library for Palm devices
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/*
+ * As in the SDK, the Berkeley calls are macros over the network library,
+ * so they never reach the host's own send(), recv() and close().
+ */
+
+#if !defined(HOST_SYS_SOCKET_H_)
+#define HOST_SYS_SOCKET_H_ 1
+
+#include <PalmOS.h>
+
+extern Err errno;
+
+#define send( socket, data, length, flags ) \
+    NetLibSend( AppNetRefnum, socket, data, length, flags, NULL, 0, \
+                AppNetTimeout, &errno )
+#define recv( socket, buffer, length, flags ) \
+    NetLibReceive( AppNetRefnum, socket, buffer, length, flags, NULL, \
+                   NULL, AppNetTimeout, &errno )
+#define close( socket ) \
+    NetLibSocketClose( AppNetRefnum, socket, AppNetTimeout, &errno )
+
+#endif /* HOST_SYS_SOCKET_H_ */
@@ -0,0 +1,224 @@
+/* arch-tag: response parser timings for vagablog
+ *
+ * Vagablog - Palm based Blog utility
+ *
+ * Copyright (C) 2003,2004,2005 Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/*
+ * Runs the captured responses in corpus/ through the response parser and
+ * reports how long each takes and how many events it gives.  The body of
+ * each response is fed in pieces the size of a GPRS segment, then of a full
+ * read buffer, the way XRParserWatch() sees it on the device.  The counts
+ * are kept here rather than in the parser so the device build doesn't pay
+ * for them.
+ *
+ *   bench [-n iterations] response ...
+ */
+
+#include <PalmOS.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "http.h"
+#include "xmlrpc.h"
+
+#define BENCH_ITERATIONS (20000)
+#define BENCH_MAX_RESPONSE (65536)
+
+static const UInt32 gSplits[] = { 536, 4096 };
+
+typedef struct BenchCount_struct {
+    UInt32 events;
+    UInt32 values;
+} BenchCount;
+
+
+/*
+ * Local prototypes (private to this file)
+ */
+
+static Boolean CountEvent( void *ctx, XREvent *event );
+static int ParseBody( const char *body, UInt32 length, UInt32 split,
+                      BenchCount *count, XRResult *fault );
+static double Seconds( void );
+static int BenchFile( const char *path, UInt32 iterations );
+
+
+/*
+ * Name:   CountEvent()
+ * Args:   ctx - the BenchCount
+ *         event - next part of the response
+ * Return: false, the whole response is always read
+ */
+
+static Boolean CountEvent( void *ctx, XREvent *event )
+{
+    BenchCount *count;
+
+    count = (BenchCount *)ctx;
+    count->events++;
+    if ( event->kind == XRE_VALUE ) {
+        count->values++;
+    }
+
+    return false;
+}
+
+
+/*
+ * Name:   ParseBody()
+ * Args:   body - response body
+ *         length - bytes in 'body'
+ *         split - bytes to feed the parser at a time
+ *         count - counts to add to
+ *         fault - filled in if the response is a fault
+ * Return: whatever XRParserEnd() does
+ */
+
+static int ParseBody( const char *body, UInt32 length, UInt32 split,
+                      BenchCount *count, XRResult *fault )
+{
+    XRParser parser;
+    UInt32 offset;
+    UInt32 piece;
+
+    XRParserStart( &parser, CountEvent, count, fault );
+    for ( offset = 0; offset < length; offset += piece ) {
+        piece = length - offset;
+        if ( piece > split ) {
+            piece = split;
+        }
+        if ( XRParserFeed( &parser, body + offset, piece ) ) {
+            break;
+        }
+    }
+
+    return XRParserEnd( &parser );
+}
+
+
+/*
+ * Name:   Seconds()
+ * Args:   none
+ * Return: the host's monotonic clock, in seconds
+ */
+
+static double Seconds( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+/*
+ * Name:   BenchFile()
+ * Args:   path - a saved response, headers and all
+ *         iterations - times to parse it at each split
+ * Return: 0 on success, -1 if the file couldn't be read or didn't parse
+ */
+
+static int BenchFile( const char *path, UInt32 iterations )
+{
+    static char response[BENCH_MAX_RESPONSE];
+    FILE *file;
+    size_t length;
+    const char *body;
+    BenchCount count;
+    XRResult fault;
+    double start;
+    double elapsed;
+    UInt32 i;
+    UInt16 s;
+
+    file = fopen( path, "rb" );
+    if ( file == NULL ) {
+        fprintf( stderr, "%s: can't open\n", path );
+        return -1;
+    }
+    length = fread( response, 1, sizeof(response) - 1, file );
+    fclose( file );
+
+    body = strstr( response, "\r\n\r\n" );
+    body = (body == NULL) ? response : body + 4;
+    length -= body - response;
+
+    for ( s = 0; s < sizeof(gSplits) / sizeof(gSplits[0]); s++ ) {
+        memset( &count, 0, sizeof(count) );
+        if ( ParseBody( body, length, gSplits[s], &count, &fault ) != 0 ) {
+            fprintf( stderr, "%s: doesn't parse\n", path );
+            return -1;
+        }
+
+        start = Seconds();
+        for ( i = 0; i < iterations; i++ ) {
+            ParseBody( body, length, gSplits[s], &count, &fault );
+        }
+        elapsed = Seconds() - start;
+
+        printf( "%-24s %5lu bytes  split %4lu  %3lu events  %3lu values  "
+                "%s  %8.2f us  %7.1f MB/s\n", path, (unsigned long)length,
+                (unsigned long)gSplits[s],
+                (unsigned long)(count.events / (iterations + 1)),
+                (unsigned long)(count.values / (iterations + 1)),
+                fault.fault ? "fault" : "ok   ",
+                elapsed * 1e6 / iterations,
+                (length * (double)iterations) / elapsed / 1e6 );
+    }
+
+    return 0;
+}
+
+
+int main( int argc, char **argv )
+{
+    UInt32 iterations;
+    int status;
+    int i;
+
+    iterations = BENCH_ITERATIONS;
+    status = 0;
+
+    for ( i = 1; i < argc; i++ ) {
+        if ( (strcmp( argv[i], "-n" ) == 0) && (i + 1 < argc) ) {
+            iterations = strtoul( argv[++i], NULL, 10 );
+            if ( iterations == 0 ) {
+                iterations = 1;
+            }
+        } else if ( BenchFile( argv[i], iterations ) != 0 ) {
+            status = 1;
+        }
+    }
+
+    return status;
+}
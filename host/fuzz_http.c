@@ -0,0 +1,166 @@
+/* tag: HTTP response fuzz target for PalmHTTP
+ * arch-tag: HTTP response fuzz target for PalmHTTP
+ *
+ * PalmHTTP - an HTTP library for Palm devices
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/*
+ * libFuzzer target for the response side of the HTTP library: the status
+ * line, the headers, Content-Length and the body reads.  A transport that
+ * replays the input stands in for the network.  The first byte of the
+ * input seeds the size of each read, and the low bit of the second says
+ * whether the body also goes through the XML-RPC parser as the watcher,
+ * which can stop the read early.  The rest is the response.
+ */
+
+#include <PalmOS.h>
+
+#include <stdint.h>
+
+#include "http.h"
+#include "xmlrpc.h"
+
+#define FUZZ_MAX_SPLIT (64)
+#define FUZZ_RESULTS_DB "FuzzResults"
+
+typedef struct FuzzLink_struct {
+    const char *response;
+    UInt32 length;
+    UInt32 offset;
+    UInt32 state;
+    UInt32 ticks;
+} FuzzLink;
+
+
+/*
+ * Local prototypes (private to this file)
+ */
+
+static Int16 FuzzOpen( void *ctx, URLTarget *url, Int32 timeout );
+static Int16 FuzzSend( void *ctx, char *data, UInt16 length,
+                       Int32 timeout );
+static Int16 FuzzRecv( void *ctx, char *buffer, UInt16 length,
+                       Int32 timeout );
+static void FuzzClose( void *ctx );
+static UInt32 FuzzTicks( void *ctx );
+
+int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size );
+
+
+/*
+ * Private globals
+ */
+
+static FuzzLink gLink;
+static HTTPTransport gFuzzTransport = {
+    FuzzOpen, FuzzSend, FuzzRecv, FuzzClose, FuzzTicks, NULL, &gLink
+};
+
+
+/*
+ * The transport
+ */
+
+static Int16 FuzzOpen( void *ctx, URLTarget *url, Int32 timeout )
+{
+    ((FuzzLink *)ctx)->offset = 0;
+    return 0;
+}
+
+static Int16 FuzzSend( void *ctx, char *data, UInt16 length, Int32 timeout )
+{
+    return length;
+}
+
+static Int16 FuzzRecv( void *ctx, char *buffer, UInt16 length,
+                       Int32 timeout )
+{
+    FuzzLink *link;
+    UInt32 piece;
+
+    link = (FuzzLink *)ctx;
+    link->state = (link->state * 1103515245) + 12345;
+    piece = ((link->state >> 16) % FUZZ_MAX_SPLIT) + 1;
+    if ( piece > length ) {
+        piece = length;
+    }
+    if ( piece > link->length - link->offset ) {
+        piece = link->length - link->offset;
+    }
+
+    MemMove( buffer, link->response + link->offset, piece );
+    link->offset += piece;
+
+    return piece;
+}
+
+static void FuzzClose( void *ctx )
+{
+}
+
+static UInt32 FuzzTicks( void *ctx )
+{
+    return ((FuzzLink *)ctx)->ticks++;
+}
+
+
+int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size )
+{
+    static Boolean started = false;
+    URLTarget url;
+    XRParser parser;
+    XRResult fault;
+
+    if ( size < 2 ) {
+        return 0;
+    }
+
+    if ( !started ) {
+        HTTPLibStart( 'Fuzz', 5 );
+        HTTPLibSetTransport( &gFuzzTransport );
+        started = true;
+    }
+
+    gLink.response = (const char *)data + 2;
+    gLink.length = size - 2;
+    gLink.state = data[0];
+
+    url.host = "example.com";
+    url.port = 80;
+    url.path = "/xmlrpc";
+
+    if ( data[1] & 1 ) {
+        XRParserStart( &parser, NULL, NULL, &fault );
+        HTTPPostWatch( &url, "<x/>", FUZZ_RESULTS_DB, XRParserWatch,
+                       &parser );
+    } else {
+        HTTPPost( &url, "<x/>", FUZZ_RESULTS_DB );
+    }
+
+    return 0;
+}
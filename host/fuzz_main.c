@@ -0,0 +1,79 @@
+/* arch-tag: fuzz target replay driver for vagablog
+ *
+ * Vagablog - Palm based Blog utility
+ *
+ * Copyright (C) 2003,2004,2005 Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/*
+ * Runs a fuzz target over files given on the command line, so the seeds
+ * and any crashers libFuzzer or AFL turn up can be replayed with a plain
+ * compiler.  Under AFL, build with this and pass "-" to read stdin.
+ *
+ *   replay_xmlrpc seeds/xmlrpc/<file> ...
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLAY_MAX_INPUT (1 << 20)
+
+int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size );
+
+
+int main( int argc, char **argv )
+{
+    static uint8_t input[REPLAY_MAX_INPUT];
+    FILE *file;
+    size_t size;
+    int i;
+
+    for ( i = 1; i < argc; i++ ) {
+        if ( strcmp( argv[i], "-" ) == 0 ) {
+            file = stdin;
+        } else {
+            file = fopen( argv[i], "rb" );
+        }
+        if ( file == NULL ) {
+            fprintf( stderr, "%s: can't open\n", argv[i] );
+            return 1;
+        }
+
+        size = fread( input, 1, sizeof(input), file );
+        if ( file != stdin ) {
+            fclose( file );
+        }
+
+        LLVMFuzzerTestOneInput( input, size );
+    }
+
+    printf( "%d inputs ran\n", argc - 1 );
+    return 0;
+}
@@ -0,0 +1,206 @@
+/* arch-tag: response parser fuzz target for vagablog
+ *
+ * Vagablog - Palm based Blog utility
+ *
+ * Copyright (C) 2003,2004,2005 Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/*
+ * libFuzzer target for the response parser.  The first byte of the input
+ * seeds the sizes the rest is fed to XRParserFeed() in, from one byte up,
+ * since a response can be cut anywhere by the network.  Every input is
+ * parsed twice: once with an event function that checks what it's given,
+ * and once into a tree that's then walked, with an arena small enough
+ * that running out of room gets exercised too.
+ */
+
+#include <PalmOS.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "http.h"
+#include "xmlrpc.h"
+
+#define FUZZ_MAX_SPLIT (64)
+#define FUZZ_ARENA_SIZE (2048)
+#define FUZZ_MAX_DEPTH (64)
+
+
+/*
+ * Local prototypes (private to this file)
+ */
+
+static UInt8 NextSplit( UInt32 *state );
+static Boolean CheckEvent( void *ctx, XREvent *event );
+static void Feed( XRParser *parser, const char *data, UInt32 length,
+                  UInt8 seed );
+static void WalkTree( XRTree *tree, XRNodeRef ref, UInt16 depth );
+
+int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size );
+
+
+/*
+ * Name:   NextSplit()
+ * Args:   state - generator state
+ * Return: the size of the next piece to feed, 1 to FUZZ_MAX_SPLIT
+ */
+
+static UInt8 NextSplit( UInt32 *state )
+{
+    *state = (*state * 1103515245) + 12345;
+    return ((*state >> 16) % FUZZ_MAX_SPLIT) + 1;
+}
+
+
+/*
+ * Name:   CheckEvent()
+ * Args:   ctx - unused
+ *         event - next part of the response
+ * Return: false, the whole input is always read
+ * Desc:   Touches every byte of the text the event claims to have, so the
+ *         address sanitizer catches a length that runs past it.
+ */
+
+static Boolean CheckEvent( void *ctx, XREvent *event )
+{
+    volatile char sum;
+    UInt16 i;
+
+    if ( (event->kind > XRE_DONE) || (event->length > XR_TEXT_LEN) ) {
+        abort();
+    }
+
+    sum = 0;
+    for ( i = 0; i < event->length; i++ ) {
+        sum += event->text[i];
+    }
+
+    return false;
+}
+
+
+/*
+ * Name:   Feed()
+ * Args:   parser - parser to feed
+ *         data - the response
+ *         length - bytes in 'data'
+ *         seed - picks the piece sizes
+ * Return: none
+ */
+
+static void Feed( XRParser *parser, const char *data, UInt32 length,
+                  UInt8 seed )
+{
+    UInt32 state;
+    UInt32 offset;
+    UInt32 piece;
+
+    state = seed;
+    for ( offset = 0; offset < length; offset += piece ) {
+        piece = NextSplit( &state );
+        if ( piece > length - offset ) {
+            piece = length - offset;
+        }
+        if ( XRParserFeed( parser, data + offset, piece ) ) {
+            break;
+        }
+    }
+}
+
+
+/*
+ * Name:   WalkTree()
+ * Args:   tree - a parsed response
+ *         ref - node to start from
+ *         depth - how far down 'ref' is
+ * Return: none
+ * Desc:   Visits every node, reading all of each scalar's text and its
+ *         terminator and looking a couple of members up in each struct.
+ */
+
+static void WalkTree( XRTree *tree, XRNodeRef ref, UInt16 depth )
+{
+    XRNodeRef child;
+    XRNode *node;
+    const char *text;
+    volatile char sum;
+    UInt16 i;
+
+    if ( depth > FUZZ_MAX_DEPTH ) {
+        abort();
+    }
+
+    sum = 0;
+    for ( child = XRTreeFirst( tree, ref ); child != XR_NO_NODE;
+            child = XRTreeNext( tree, child ) ) {
+        node = XRTreeNode( tree, child );
+        if ( node->type == XRN_STRUCT ) {
+            XRTreeMember( tree, child, "blogid" );
+            XRTreeMember( tree, child, "faultString" );
+        } else if ( node->type != XRN_ARRAY ) {
+            text = XRTreeText( tree, child );
+            for ( i = 0; i <= node->length; i++ ) {
+                sum += text[i];
+            }
+        }
+        WalkTree( tree, child, depth + 1 );
+    }
+}
+
+
+int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size )
+{
+    static char buffer[FUZZ_ARENA_SIZE];
+    XRParser parser;
+    XRResult fault;
+    XRArena arena;
+    XRTree tree;
+
+    if ( size < 1 ) {
+        return 0;
+    }
+
+    XRParserStart( &parser, CheckEvent, NULL, &fault );
+    Feed( &parser, (const char *)data + 1, size - 1, data[0] );
+    XRParserEnd( &parser );
+
+    arena.base = buffer;
+    arena.size = sizeof(buffer);
+    arena.used = 0;
+    if ( XRTreeStart( &tree, &arena ) != 0 ) {
+        abort();
+    }
+    XRParserStart( &parser, XRTreeEvent, &tree, &fault );
+    Feed( &parser, (const char *)data + 1, size - 1, data[0] );
+    if ( (XRParserEnd( &parser ) == 0) && !tree.failed ) {
+        WalkTree( &tree, tree.root, 0 );
+    }
+
+    return 0;
+}
@@ -0,0 +1,316 @@
+/* arch-tag: simulated network scenario runs for vagablog
+ *
+ * Vagablog - Palm based Blog utility
+ *
+ * Copyright (C) 2003,2004,2005 Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/*
+ * Runs the NetSimScenario setups from netsim.c without a device.  Each
+ * scenario makes the requests vagablog would: a blog list refresh, the
+ * system.listMethods probe, and a post with a refresh behind it, batched
+ * when the server takes system.multicall.  The HTTPStats for every request
+ * are printed, along with how many segments the request went out in and
+ * how long it waited on a full window.  Times are ticks of the simulated
+ * clock.
+ *
+ *   netsim_run [-l entry length] [refresh | large | drop] ...
+ *
+ * With no scenarios named, all of them are run.
+ */
+
+#include <PalmOS.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "http.h"
+#include "netsim.h"
+#include "xmlrpc.h"
+
+#define RUN_TIMEOUT (20)
+#define RUN_WRITE_BLOCK (4096)
+#define RUN_SHORT_ENTRY (200)
+#define RUN_LONG_ENTRY (6000)
+#define RUN_MAX_ENTRY (30000)
+#define RUN_TREE_SIZE (8192)
+
+typedef struct RunScenario_struct {
+    const char *name;
+    NetSimScenario scenario;
+    Boolean refreshFirst;
+    Boolean probe;
+    Boolean longEntry;
+} RunScenario;
+
+static const RunScenario gScenarios[] = {
+    { "refresh", NSS_RefreshThenPost, true, true, false },
+    { "large", NSS_LargePost, false, true, true },
+    { "drop", NSS_DropAfterHeaders, false, false, false }
+};
+
+
+/*
+ * Local prototypes (private to this file)
+ */
+
+static void ReportStep( const char *step, int status, const XRCall *call );
+static int RunCalls( const char *step, XRCall *calls, UInt16 count,
+                     UInt8 *multicall );
+static void RunScenarioSteps( const RunScenario *run, UInt32 entryLength );
+
+
+/*
+ * Private globals
+ */
+
+static char gEntry[RUN_MAX_ENTRY + 1];
+static char gTree[RUN_TREE_SIZE];
+static XRBatch gBatch;
+static NetSimStats gLinkBefore;
+static URLTarget gTarget = { "example.com", 80, "/xmlrpc" };
+
+static const XRParam gUsersBlogs[] = {
+    { XRT_STRING, false, "vagablog" },
+    { XRT_STRING, false, "me" },
+    { XRT_STRING, false, "secret" }
+};
+
+static XRParam gNewPost[] = {
+    { XRT_STRING, false, "vagablog" },
+    { XRT_STRING, false, "1001" },
+    { XRT_STRING, false, "me" },
+    { XRT_STRING, false, "secret" },
+    { XRT_STRING, true, gEntry },
+    { XRT_BOOLEAN, false, "1" }
+};
+
+
+/*
+ * Name:   ReportStep()
+ * Args:   step - what the request was for
+ *         status - what XRBatchRun() returned
+ *         call - the last call made, for its result
+ * Return: none
+ */
+
+static void ReportStep( const char *step, int status, const XRCall *call )
+{
+    HTTPStats stats;
+    NetSimStats link;
+    const char *result;
+
+    HTTPLibGetStats( &stats );
+    NetSimGetStats( &link );
+
+    if ( status != 0 ) {
+        result = "failed";
+    } else if ( call->result.fault ) {
+        result = "fault";
+    } else {
+        result = "ok";
+    }
+
+    printf( "  %-16s sent %6lu  received %5lu  first byte %5lu  "
+            "done %5lu  saves %2lu  segments %3lu  stalls %2lu "
+            "(%5lu ms)  %s\n", step, (unsigned long)stats.bytesSent,
+            (unsigned long)stats.bytesReceived,
+            (unsigned long)stats.firstByteTicks,
+            (unsigned long)stats.totalTicks,
+            (unsigned long)stats.storageWrites,
+            (unsigned long)(link.segmentsSent - gLinkBefore.segmentsSent),
+            (unsigned long)(link.windowStalls - gLinkBefore.windowStalls),
+            (unsigned long)(link.stallMs - gLinkBefore.stallMs), result );
+
+    gLinkBefore = link;
+}
+
+
+/*
+ * Name:   RunCalls()
+ * Args:   step - what the calls are for
+ *         calls - the calls to make
+ *         count - number of 'calls'
+ *         multicall - whether the server takes system.multicall
+ * Return: 0 if the server answered, -1 if not
+ * Desc:   Makes the calls as one request when they can be batched, and as
+ *         a request each otherwise, reporting every request.  The last
+ *         response is left in gBatch's tree.
+ */
+
+static int RunCalls( const char *step, XRCall *calls, UInt16 count,
+                     UInt8 *multicall )
+{
+    UInt16 i;
+    int status;
+
+    gBatch.multicall = multicall;
+
+    if ( (count > 1) && (*multicall == XR_MULTICALL_YES) ) {
+        gBatch.calls = calls;
+        gBatch.callCount = count;
+        status = XRBatchRun( &gTarget, &gBatch, gTree, sizeof(gTree) );
+        ReportStep( step, status, &(calls[0]) );
+        return (status == 0) ? 0 : -1;
+    }
+
+    for ( i = 0; i < count; i++ ) {
+        gBatch.calls = &(calls[i]);
+        gBatch.callCount = 1;
+        status = XRBatchRun( &gTarget, &gBatch, gTree, sizeof(gTree) );
+        ReportStep( (i == 0) ? step : "refresh", status, &(calls[i]) );
+        if ( status != 0 ) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   RunScenarioSteps()
+ * Args:   run - the scenario and what the app does in it
+ *         entryLength - size of a long entry
+ * Return: none
+ */
+
+static void RunScenarioSteps( const RunScenario *run, UInt32 entryLength )
+{
+    XRCall calls[2];
+    XRTree *tree;
+    XRNodeRef method;
+    UInt8 multicall;
+    UInt32 length;
+    UInt32 i;
+
+    printf( "%s:\n", run->name );
+
+    HTTPLibStart( 'VBlg', RUN_TIMEOUT );
+    HTTPLibSetTransport( NetSimLoadScenario( run->scenario ) );
+    HTTPLibSetWriteBlock( RUN_WRITE_BLOCK );
+    HTTPLibSetNoDelay( true );
+    MemSet( &gLinkBefore, sizeof(gLinkBefore), 0 );
+
+    multicall = XR_MULTICALL_UNKNOWN;
+    MemSet( calls, sizeof(calls), 0 );
+
+    if ( run->refreshFirst ) {
+        calls[0].method = "blogger.getUsersBlogs";
+        calls[0].params = gUsersBlogs;
+        calls[0].paramCount = 3;
+        if ( RunCalls( "refresh", calls, 1, &multicall ) != 0 ) {
+            HTTPLibStop();
+            return;
+        }
+    }
+
+    /* The probe XRBatchRun() would make, done here so it's reported */
+    if ( run->probe ) {
+        calls[0].method = "system.listMethods";
+        calls[0].params = NULL;
+        calls[0].paramCount = 0;
+        if ( RunCalls( "probe", calls, 1, &multicall ) != 0 ) {
+            HTTPLibStop();
+            return;
+        }
+
+        multicall = XR_MULTICALL_NO;
+        tree = &(gBatch.tree);
+        method = XR_NO_NODE;
+        if ( calls[0].value != XR_NO_NODE ) {
+            method = XRTreeFirst( tree, calls[0].value );
+        }
+        while ( method != XR_NO_NODE ) {
+            if ( StrCompare( XRTreeText( tree, method ),
+                             "system.multicall" ) == 0 ) {
+                multicall = XR_MULTICALL_YES;
+            }
+            method = XRTreeNext( tree, method );
+        }
+    }
+
+    length = run->longEntry ? entryLength : RUN_SHORT_ENTRY;
+    for ( i = 0; i < length; i++ ) {
+        gEntry[i] = "The quick brown fox <jumps> & runs. "[i % 36];
+    }
+    gEntry[length] = '\0';
+
+    calls[0].method = "blogger.newPost";
+    calls[0].params = gNewPost;
+    calls[0].paramCount = 6;
+    calls[1].method = "blogger.getUsersBlogs";
+    calls[1].params = gUsersBlogs;
+    calls[1].paramCount = 3;
+    RunCalls( "post", calls, run->probe ? 2 : 1, &multicall );
+
+    HTTPLibStop();
+}
+
+
+int main( int argc, char **argv )
+{
+    UInt32 entryLength;
+    UInt16 s;
+    int named;
+    int i;
+
+    entryLength = RUN_LONG_ENTRY;
+    named = 0;
+
+    for ( i = 1; i < argc; i++ ) {
+        if ( (strcmp( argv[i], "-l" ) == 0) && (i + 1 < argc) ) {
+            entryLength = strtoul( argv[++i], NULL, 10 );
+            if ( entryLength > RUN_MAX_ENTRY ) {
+                entryLength = RUN_MAX_ENTRY;
+            }
+            continue;
+        }
+
+        named++;
+        for ( s = 0; s < sizeof(gScenarios) / sizeof(gScenarios[0]); s++ ) {
+            if ( strcmp( argv[i], gScenarios[s].name ) == 0 ) {
+                RunScenarioSteps( &(gScenarios[s]), entryLength );
+                break;
+            }
+        }
+        if ( s == sizeof(gScenarios) / sizeof(gScenarios[0]) ) {
+            fprintf( stderr, "%s: no such scenario\n", argv[i] );
+            return 1;
+        }
+    }
+
+    if ( named == 0 ) {
+        for ( s = 0; s < sizeof(gScenarios) / sizeof(gScenarios[0]); s++ ) {
+            RunScenarioSteps( &(gScenarios[s]), entryLength );
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,629 @@
+/* tag: host implementation of the PalmOS calls PalmHTTP uses
+ * arch-tag: host implementation of the PalmOS calls PalmHTTP uses
+ *
+ * PalmHTTP - an HTTP library for Palm devices
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/*
+ * The calls declared in the host PalmOS.h, on top of the C library.  Only
+ * as much behaviour as the library relies on is copied: a stream DB is one
+ * block of memory rather than a set of records, a database only knows its
+ * type and creator, and nothing is kept between runs.  Running out of
+ * memory or table space aborts, since a test that carries on after that
+ * isn't testing anything.
+ */
+
+#include <PalmOS.h>
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define HOST_MAX_DBS (16)
+#define HOST_MAX_RECORDS (64)
+#define HOST_MAX_STREAMS (16)
+#define HOST_MAX_FILES (16)
+#define HOST_NAME_LEN (32)
+#define HOST_FORMAT_LEN (256)
+
+struct HostHandle_struct {
+    void *data;
+    UInt32 size;
+};
+
+struct HostDB_struct {
+    char name[HOST_NAME_LEN];
+    UInt32 type;
+    UInt32 creator;
+    UInt16 count;
+    MemHandle records[HOST_MAX_RECORDS];
+};
+
+typedef struct HostStreamData_struct {
+    char name[HOST_NAME_LEN];
+    char *data;
+    UInt32 size;
+    UInt32 allocated;
+} HostStreamData;
+
+struct HostStream_struct {
+    HostStreamData *file;
+    UInt32 position;
+};
+
+
+/*
+ * Local prototypes (private to this file)
+ */
+
+static void *HostAlloc( size_t size );
+static MemHandle HandleNew( UInt32 size );
+static HostStreamData *FindStream( const Char *name, Boolean create );
+
+
+/*
+ * Private globals
+ */
+
+UInt16 AppNetRefnum;
+Int32 AppNetTimeout;
+
+static struct HostDB_struct gDBs[HOST_MAX_DBS];
+static UInt16 gDBCount = 0;
+static HostStreamData gStreams[HOST_MAX_STREAMS];
+static FILE *gFiles[HOST_MAX_FILES];
+
+
+/*
+ * Name:   HostAlloc()
+ * Args:   size - bytes wanted
+ * Return: zeroed memory, never NULL
+ */
+
+static void *HostAlloc( size_t size )
+{
+    void *ptr;
+
+    ptr = calloc( 1, (size != 0) ? size : 1 );
+    if ( ptr == NULL ) {
+        fprintf( stderr, "host: out of memory\n" );
+        abort();
+    }
+
+    return ptr;
+}
+
+
+/*
+ * Memory
+ */
+
+MemPtr MemPtrNew( UInt32 size )
+{
+    return malloc( (size != 0) ? size : 1 );
+}
+
+Err MemPtrFree( MemPtr ptr )
+{
+    free( ptr );
+    return errNone;
+}
+
+MemPtr MemHandleLock( MemHandle handle )
+{
+    return handle->data;
+}
+
+Err MemHandleUnlock( MemHandle handle )
+{
+    return errNone;
+}
+
+UInt32 MemHandleSize( MemHandle handle )
+{
+    return handle->size;
+}
+
+Err MemSet( void *dest, Int32 length, UInt8 value )
+{
+    memset( dest, value, length );
+    return errNone;
+}
+
+Err MemMove( void *dest, const void *src, Int32 length )
+{
+    memmove( dest, src, length );
+    return errNone;
+}
+
+Int16 MemCmp( const void *a, const void *b, Int32 length )
+{
+    return memcmp( a, b, length );
+}
+
+
+/*
+ * Strings
+ */
+
+Int16 StrLen( const Char *str )
+{
+    return strlen( str );
+}
+
+Char *StrCopy( Char *dest, const Char *src )
+{
+    return strcpy( dest, src );
+}
+
+Char *StrNCopy( Char *dest, const Char *src, Int16 length )
+{
+    return strncpy( dest, src, length );
+}
+
+Int16 StrCompare( const Char *a, const Char *b )
+{
+    return strcmp( a, b );
+}
+
+Int16 StrCaselessCompare( const Char *a, const Char *b )
+{
+    return strcasecmp( a, b );
+}
+
+Int16 StrNCaselessCompare( const Char *a, const Char *b, Int32 length )
+{
+    return strncasecmp( a, b, length );
+}
+
+Int32 StrAToI( const Char *str )
+{
+    return atol( str );
+}
+
+Char *StrIToA( Char *dest, Int32 value )
+{
+    sprintf( dest, "%d", value );
+    return dest;
+}
+
+Boolean TxtCharIsSpace( Char ch )
+{
+    return isspace( (unsigned char)ch ) != 0;
+}
+
+
+/*
+ * Name:   StrPrintF()
+ * Args:   as for sprintf()
+ * Return: length of the result
+ * Desc:   On the device an 'l' marks a 32 bit argument, which is an int
+ *         here, so it's dropped before the format is handed on.
+ */
+
+Int16 StrPrintF( Char *dest, const Char *format, ... )
+{
+    char hostFormat[HOST_FORMAT_LEN];
+    va_list args;
+    UInt16 i;
+    Int16 result;
+
+    for ( i = 0; (*format != '\0') && (i < HOST_FORMAT_LEN - 1); format++ ) {
+        hostFormat[i++] = *format;
+        if ( (*format == '%') && (format[1] == 'l') ) {
+            format++;
+        }
+    }
+    hostFormat[i] = '\0';
+
+    va_start( args, format );
+    result = vsprintf( dest, hostFormat, args );
+    va_end( args );
+
+    return result;
+}
+
+
+/*
+ * Databases
+ */
+
+static MemHandle HandleNew( UInt32 size )
+{
+    MemHandle handle;
+
+    handle = (MemHandle)HostAlloc( sizeof(struct HostHandle_struct) );
+    handle->data = HostAlloc( size );
+    handle->size = size;
+
+    return handle;
+}
+
+DmOpenRef DmOpenDatabaseByTypeCreator( UInt32 type, UInt32 creator,
+                                       UInt16 mode )
+{
+    UInt16 i;
+
+    for ( i = 0; i < gDBCount; i++ ) {
+        if ( (gDBs[i].type == type) && (gDBs[i].creator == creator) ) {
+            return &(gDBs[i]);
+        }
+    }
+
+    return NULL;
+}
+
+Err DmCreateDatabase( UInt16 cardNo, const Char *name, UInt32 creator,
+                      UInt32 type, Boolean resDB )
+{
+    if ( gDBCount == HOST_MAX_DBS ) {
+        fprintf( stderr, "host: too many databases\n" );
+        abort();
+    }
+
+    strncpy( gDBs[gDBCount].name, name, HOST_NAME_LEN - 1 );
+    gDBs[gDBCount].type = type;
+    gDBs[gDBCount].creator = creator;
+    gDBCount++;
+
+    return errNone;
+}
+
+Err DmCloseDatabase( DmOpenRef db )
+{
+    return errNone;
+}
+
+UInt16 DmNumRecords( DmOpenRef db )
+{
+    return db->count;
+}
+
+MemHandle DmQueryRecord( DmOpenRef db, UInt16 index )
+{
+    return (index < db->count) ? db->records[index] : NULL;
+}
+
+MemHandle DmGetRecord( DmOpenRef db, UInt16 index )
+{
+    return DmQueryRecord( db, index );
+}
+
+MemHandle DmNewRecord( DmOpenRef db, UInt16 *index, UInt32 size )
+{
+    UInt16 at;
+
+    if ( db->count == HOST_MAX_RECORDS ) {
+        fprintf( stderr, "host: too many records in %s\n", db->name );
+        abort();
+    }
+
+    at = (*index > db->count) ? db->count : *index;
+    memmove( &(db->records[at + 1]), &(db->records[at]),
+             (db->count - at) * sizeof(MemHandle) );
+    db->records[at] = HandleNew( size );
+    db->count++;
+    *index = at;
+
+    return db->records[at];
+}
+
+Err DmReleaseRecord( DmOpenRef db, UInt16 index, Boolean dirty )
+{
+    return errNone;
+}
+
+Err DmRemoveRecord( DmOpenRef db, UInt16 index )
+{
+    if ( index >= db->count ) {
+        return 1;
+    }
+
+    free( db->records[index]->data );
+    free( db->records[index] );
+    db->count--;
+    memmove( &(db->records[index]), &(db->records[index + 1]),
+             (db->count - index) * sizeof(MemHandle) );
+
+    return errNone;
+}
+
+Err DmWrite( void *record, UInt32 offset, const void *src, UInt32 length )
+{
+    memcpy( (char *)record + offset, src, length );
+    return errNone;
+}
+
+
+/*
+ * File streams
+ */
+
+static HostStreamData *FindStream( const Char *name, Boolean create )
+{
+    UInt16 i;
+    HostStreamData *unused;
+
+    unused = NULL;
+    for ( i = 0; i < HOST_MAX_STREAMS; i++ ) {
+        if ( gStreams[i].name[0] == '\0' ) {
+            if ( unused == NULL ) {
+                unused = &(gStreams[i]);
+            }
+        } else if ( strcmp( gStreams[i].name, name ) == 0 ) {
+            return &(gStreams[i]);
+        }
+    }
+
+    if ( !create ) {
+        return NULL;
+    }
+    if ( unused == NULL ) {
+        fprintf( stderr, "host: too many streams\n" );
+        abort();
+    }
+
+    strncpy( unused->name, name, HOST_NAME_LEN - 1 );
+    return unused;
+}
+
+FileHand FileOpen( UInt16 cardNo, const Char *name, UInt32 type,
+                   UInt32 creator, UInt32 openMode, Err *err )
+{
+    HostStreamData *file;
+    FileHand stream;
+
+    file = FindStream( name, (openMode & fileModeReadWrite) != 0 );
+    if ( file == NULL ) {
+        if ( err != NULL ) {
+            *err = 1;
+        }
+        return NULL;
+    }
+
+    if ( openMode & fileModeReadWrite ) {
+        file->size = 0;
+    }
+
+    stream = (FileHand)HostAlloc( sizeof(struct HostStream_struct) );
+    stream->file = file;
+    if ( err != NULL ) {
+        *err = errNone;
+    }
+
+    return stream;
+}
+
+Err FileClose( FileHand stream )
+{
+    free( stream );
+    return errNone;
+}
+
+Int32 FileRead( FileHand stream, void *buffer, Int32 objSize,
+                Int32 numObj, Err *err )
+{
+    UInt32 length;
+
+    length = objSize * numObj;
+    if ( length > stream->file->size - stream->position ) {
+        length = stream->file->size - stream->position;
+    }
+
+    memcpy( buffer, stream->file->data + stream->position, length );
+    stream->position += length;
+    if ( err != NULL ) {
+        *err = errNone;
+    }
+
+    return length / objSize;
+}
+
+Int32 FileWrite( FileHand stream, const void *data, Int32 objSize,
+                 Int32 numObj, Err *err )
+{
+    HostStreamData *file;
+    UInt32 length;
+
+    file = stream->file;
+    length = objSize * numObj;
+    if ( file->size + length > file->allocated ) {
+        file->allocated = (file->size + length) * 2;
+        file->data = realloc( file->data, file->allocated );
+        if ( file->data == NULL ) {
+            fprintf( stderr, "host: out of memory\n" );
+            abort();
+        }
+    }
+
+    memcpy( file->data + file->size, data, length );
+    file->size += length;
+    if ( err != NULL ) {
+        *err = errNone;
+    }
+
+    return numObj;
+}
+
+Int32 FileTell( FileHand stream, Int32 *size, Err *err )
+{
+    if ( size != NULL ) {
+        *size = stream->file->size;
+    }
+    if ( err != NULL ) {
+        *err = errNone;
+    }
+
+    return stream->position;
+}
+
+
+/*
+ * VFS
+ */
+
+Err VFSFileOpen( UInt16 volRef, const Char *path, UInt16 openMode,
+                 FileRef *file )
+{
+    FileRef i;
+
+    for ( i = 1; i < HOST_MAX_FILES; i++ ) {
+        if ( gFiles[i] == NULL ) {
+            gFiles[i] = fopen( path, "rb" );
+            if ( gFiles[i] == NULL ) {
+                return 1;
+            }
+            *file = i;
+            return errNone;
+        }
+    }
+
+    return 1;
+}
+
+Err VFSFileClose( FileRef file )
+{
+    fclose( gFiles[file] );
+    gFiles[file] = NULL;
+    return errNone;
+}
+
+Err VFSFileRead( FileRef file, UInt32 length, void *buffer, UInt32 *read )
+{
+    size_t got;
+
+    got = fread( buffer, 1, length, gFiles[file] );
+    if ( read != NULL ) {
+        *read = got;
+    }
+
+    return ((got == 0) && (length != 0)) ? vfsErrFileEOF : errNone;
+}
+
+Err VFSFileSize( FileRef file, UInt32 *size )
+{
+    long position;
+
+    position = ftell( gFiles[file] );
+    fseek( gFiles[file], 0, SEEK_END );
+    *size = ftell( gFiles[file] );
+    fseek( gFiles[file], position, SEEK_SET );
+
+    return errNone;
+}
+
+
+/*
+ * Time.  Ticks are on the host's monotonic clock, seconds on the wall
+ * clock counted from 1904 like the device's.
+ */
+
+UInt16 SysTicksPerSecond( void )
+{
+    return 100;
+}
+
+UInt32 TimGetTicks( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (UInt32)(now.tv_sec * 100 + now.tv_nsec / 10000000);
+}
+
+UInt32 TimGetSeconds( void )
+{
+    return (UInt32)time( NULL ) + 2082844800UL;
+}
+
+
+/*
+ * Network library.  There's no network, so nothing connects.
+ */
+
+Err SysLibFind( const Char *name, UInt16 *refNum )
+{
+    *refNum = 1;
+    return errNone;
+}
+
+Err NetLibOpen( UInt16 refNum, UInt16 *ifErr )
+{
+    *ifErr = 0;
+    return errNone;
+}
+
+Err NetLibClose( UInt16 refNum, UInt16 immediate )
+{
+    return errNone;
+}
+
+Err NetLibConnectionRefresh( UInt16 refNum, Boolean refresh, UInt8 *allUp,
+                             UInt16 *netIFErr )
+{
+    *allUp = false;
+    *netIFErr = 1;
+    return 1;
+}
+
+Int16 NetLibSocketOptionSet( UInt16 refNum, NetSocketRef socket,
+                             UInt16 level, UInt16 option, void *value,
+                             UInt16 length, Int32 timeout, Err *err )
+{
+    return -1;
+}
+
+NetSocketRef NetUTCPOpen( const Char *host, const Char *service,
+                          Int16 port )
+{
+    return -1;
+}
+
+Int16 NetLibSend( UInt16 refNum, NetSocketRef socket, const void *data,
+                  UInt16 length, UInt16 flags, void *to, UInt16 toLength,
+                  Int32 timeout, Err *err )
+{
+    return -1;
+}
+
+Int16 NetLibReceive( UInt16 refNum, NetSocketRef socket, void *buffer,
+                     UInt16 length, UInt16 flags, void *from,
+                     UInt16 *fromLength, Int32 timeout, Err *err )
+{
+    return -1;
+}
+
+Int16 NetLibSocketClose( UInt16 refNum, NetSocketRef socket,
+                         Int32 timeout, Err *err )
+{
+    return -1;
+}
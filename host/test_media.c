@@ -0,0 +1,436 @@
+/* arch-tag: media upload tests for vagablog
+ *
+ * Vagablog - Palm based Blog utility
+ *
+ * Copyright (C) 2003,2004,2005 Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/*
+ * Checks the metaWeblog.newMediaObject body that XRMediaBody() streams out.
+ * Files of sizes either side of the encoder's window and of a base64
+ * group are read from a stream DB and from a VFS file.  Each one is built
+ * into a buffer with XRBuildString(), and sent with HTTPPostBody() through
+ * a transport that keeps what it's sent.  The base64 has to decode back to
+ * the file, and what's sent has to match the Content-Length counted up
+ * front.
+ */
+
+#include <PalmOS.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "http.h"
+#include "xmlrpc.h"
+
+#define TEST_MAX_FILE (5000)
+#define TEST_MAX_REQUEST (8192)
+#define TEST_STREAM_DB "MediaTestData"
+#define TEST_RESULTS_DB "MediaTestResults"
+
+typedef struct Capture_struct {
+    char sent[TEST_MAX_REQUEST];
+    UInt32 sentLength;
+    const char *response;
+    UInt32 offset;
+    UInt32 ticks;
+} Capture;
+
+static const UInt32 gSizes[] = {
+    0, 1, 2, 3, 4, 95, 96, 97, 98, 192, 1000, TEST_MAX_FILE
+};
+
+static const char gMediaResponse[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: text/xml\r\n"
+    "\r\n"
+    "<?xml version=\"1.0\"?><methodResponse><params><param><value><struct>"
+    "<member><name>url</name><value><string>http://example.com/p.jpg"
+    "</string></value></member></struct></value></param></params>"
+    "</methodResponse>";
+
+
+/*
+ * Local prototypes (private to this file)
+ */
+
+static Int16 CaptureOpen( void *ctx, URLTarget *url, Int32 timeout );
+static Int16 CaptureSend( void *ctx, char *data, UInt16 length,
+                          Int32 timeout );
+static Int16 CaptureRecv( void *ctx, char *buffer, UInt16 length,
+                          Int32 timeout );
+static void CaptureClose( void *ctx );
+static UInt32 CaptureTicks( void *ctx );
+
+static int Base64Value( char ch );
+static Int32 DecodeBits( const char *request, UInt32 length, UInt8 *out );
+static int OpenSource( XRSource *source, int kind, const UInt8 *file,
+                       UInt32 size, const char *path );
+static int CheckBuffer( int kind, const UInt8 *file, UInt32 size,
+                        const char *path );
+static int CheckSend( int kind, const UInt8 *file, UInt32 size,
+                      const char *path );
+
+
+/*
+ * Private globals
+ */
+
+static Capture gCapture;
+static HTTPTransport gCaptureTransport = {
+    CaptureOpen, CaptureSend, CaptureRecv, CaptureClose, CaptureTicks,
+    NULL, &gCapture
+};
+
+
+/*
+ * The transport
+ */
+
+static Int16 CaptureOpen( void *ctx, URLTarget *url, Int32 timeout )
+{
+    ((Capture *)ctx)->offset = 0;
+    return 0;
+}
+
+static Int16 CaptureSend( void *ctx, char *data, UInt16 length,
+                          Int32 timeout )
+{
+    Capture *capture;
+
+    capture = (Capture *)ctx;
+    if ( capture->sentLength + length > TEST_MAX_REQUEST ) {
+        return -1;
+    }
+
+    memcpy( capture->sent + capture->sentLength, data, length );
+    capture->sentLength += length;
+
+    return length;
+}
+
+static Int16 CaptureRecv( void *ctx, char *buffer, UInt16 length,
+                          Int32 timeout )
+{
+    Capture *capture;
+    UInt32 remaining;
+
+    capture = (Capture *)ctx;
+    remaining = strlen( capture->response ) - capture->offset;
+    if ( length > remaining ) {
+        length = remaining;
+    }
+
+    memcpy( buffer, capture->response + capture->offset, length );
+    capture->offset += length;
+
+    return length;
+}
+
+static void CaptureClose( void *ctx )
+{
+}
+
+static UInt32 CaptureTicks( void *ctx )
+{
+    return ((Capture *)ctx)->ticks++;
+}
+
+
+/*
+ * Name:   Base64Value()
+ * Args:   ch - a base64 character
+ * Return: its value, -1 for padding or anything else
+ */
+
+static int Base64Value( char ch )
+{
+    static const char chars[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const char *at;
+
+    if ( ch == '\0' ) {
+        return -1;
+    }
+    at = strchr( chars, ch );
+
+    return (at == NULL) ? -1 : (int)(at - chars);
+}
+
+
+/*
+ * Name:   DecodeBits()
+ * Args:   request - an encoded newMediaObject call
+ *         length - bytes in 'request'
+ *         out - where to put the decoded file
+ * Return: bytes decoded, -1 if the base64 is missing or malformed
+ */
+
+static Int32 DecodeBits( const char *request, UInt32 length, UInt8 *out )
+{
+    static const char open[] = "<member><name>bits</name><value><base64>";
+    char copy[TEST_MAX_REQUEST + 1];
+    const char *start;
+    const char *end;
+    Int32 decoded;
+    int values[4];
+    int i;
+
+    memcpy( copy, request, length );
+    copy[length] = '\0';
+
+    start = strstr( copy, open );
+    if ( start == NULL ) {
+        return -1;
+    }
+    start += strlen( open );
+    end = strstr( start, "</base64></value></member>" );
+    if ( (end == NULL) || (((end - start) % 4) != 0) ) {
+        return -1;
+    }
+
+    decoded = 0;
+    for ( ; start < end; start += 4 ) {
+        for ( i = 0; i < 4; i++ ) {
+            values[i] = Base64Value( start[i] );
+        }
+        if ( (values[0] < 0) || (values[1] < 0) ) {
+            return -1;
+        }
+        out[decoded++] = (values[0] << 2) | (values[1] >> 4);
+        if ( values[2] >= 0 ) {
+            out[decoded++] = ((values[1] & 0xF) << 4) | (values[2] >> 2);
+        }
+        if ( values[3] >= 0 ) {
+            out[decoded++] = ((values[2] & 0x3) << 6) | values[3];
+        }
+        if ( ((values[2] < 0) || (values[3] < 0)) && (start + 4 != end) ) {
+            return -1;
+        }
+    }
+
+    return decoded;
+}
+
+
+/*
+ * Name:   OpenSource()
+ * Args:   source - filled in
+ *         kind - XRS_STREAM or XRS_VFS
+ *         file - what the source should hold
+ *         size - bytes in 'file'
+ *         path - host file to use for XRS_VFS
+ * Return: 0 on success, -1 if the source couldn't be set up
+ */
+
+static int OpenSource( XRSource *source, int kind, const UInt8 *file,
+                       UInt32 size, const char *path )
+{
+    FileHand stream;
+    FILE *host;
+
+    if ( kind == XRS_STREAM ) {
+        stream = FileOpen( 0, TEST_STREAM_DB, 'DATA', 'VBlg',
+                           fileModeReadWrite, NULL );
+        FileWrite( stream, file, 1, size, NULL );
+        FileClose( stream );
+        return XRSourceOpenStream( source, TEST_STREAM_DB );
+    }
+
+    host = fopen( path, "wb" );
+    if ( host == NULL ) {
+        return -1;
+    }
+    fwrite( file, 1, size, host );
+    fclose( host );
+
+    return XRSourceOpenVFS( source, 1, path );
+}
+
+
+/*
+ * Name:   CheckBuffer()
+ * Args:   as for OpenSource()
+ * Return: 0 if the body built into a buffer is right, -1 if not
+ */
+
+static int CheckBuffer( int kind, const UInt8 *file, UInt32 size,
+                        const char *path )
+{
+    static char request[TEST_MAX_REQUEST];
+    static UInt8 decoded[TEST_MAX_FILE];
+    XRSource source;
+    XRMedia media;
+    HTTPBody body;
+    Int32 length;
+
+    if ( OpenSource( &source, kind, file, size, path ) != 0 ) {
+        return -1;
+    }
+
+    media.blogID = "1001";
+    media.name = "me";
+    media.pass = "secret";
+    media.fileName = "photo <1>.jpg";
+    media.mimeType = "image/jpeg";
+    media.source = &source;
+    XRMediaBody( &media, &body );
+
+    length = XRBuildString( &media.build, request, sizeof(request) );
+    XRSourceClose( &source );
+
+    if ( (length < 0) || ((UInt32)length != body.length) ) {
+        return -1;
+    }
+    if ( strstr( request, "<string>photo &lt;1&gt;.jpg</string>" ) == NULL ) {
+        return -1;
+    }
+    if ( (DecodeBits( request, length, decoded ) != (Int32)size) ||
+            (memcmp( decoded, file, size ) != 0) ) {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   CheckSend()
+ * Args:   as for OpenSource()
+ * Return: 0 if the body sent through HTTPPostBody() is right, -1 if not
+ */
+
+static int CheckSend( int kind, const UInt8 *file, UInt32 size,
+                      const char *path )
+{
+    static UInt8 decoded[TEST_MAX_FILE];
+    XRSource source;
+    XRMedia media;
+    HTTPBody body;
+    URLTarget url;
+    const char *sentBody;
+    const char *header;
+    UInt32 bodyLength;
+
+    if ( OpenSource( &source, kind, file, size, path ) != 0 ) {
+        return -1;
+    }
+
+    media.blogID = "1001";
+    media.name = "me";
+    media.pass = "secret";
+    media.fileName = "photo.jpg";
+    media.mimeType = "image/jpeg";
+    media.source = &source;
+    XRMediaBody( &media, &body );
+
+    gCapture.sentLength = 0;
+    gCapture.response = gMediaResponse;
+    url.host = "example.com";
+    url.port = 80;
+    url.path = "/xmlrpc";
+
+    if ( HTTPPostBody( &url, &body, TEST_RESULTS_DB, NULL, NULL )
+            != HTTPErr_OK ) {
+        XRSourceClose( &source );
+        return -1;
+    }
+    XRSourceClose( &source );
+
+    gCapture.sent[gCapture.sentLength] = '\0';
+    header = strstr( gCapture.sent, "Content-Length: " );
+    sentBody = strstr( gCapture.sent, "\r\n\r\n" );
+    if ( (header == NULL) || (sentBody == NULL) ) {
+        return -1;
+    }
+    sentBody += 4;
+    bodyLength = gCapture.sentLength - (sentBody - gCapture.sent);
+
+    if ( (strtoul( header + 16, NULL, 10 ) != bodyLength) ||
+            (bodyLength != body.length) ) {
+        return -1;
+    }
+    if ( (DecodeBits( sentBody, bodyLength, decoded ) != (Int32)size) ||
+            (memcmp( decoded, file, size ) != 0) ) {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int main( void )
+{
+    static UInt8 file[TEST_MAX_FILE];
+    char path[] = "/tmp/vagablog-mediaXXXXXX";
+    int failed;
+    int kind;
+    int fd;
+    UInt32 i;
+    UInt16 s;
+
+    for ( i = 0; i < TEST_MAX_FILE; i++ ) {
+        file[i] = (UInt8)((i * 131) ^ (i >> 3));
+    }
+
+    fd = mkstemp( path );
+    if ( fd < 0 ) {
+        fprintf( stderr, "can't make a temporary file\n" );
+        return 1;
+    }
+    close( fd );
+
+    HTTPLibStart( 'VBlg', 5 );
+    HTTPLibSetTransport( &gCaptureTransport );
+
+    failed = 0;
+    for ( kind = XRS_STREAM; kind <= XRS_VFS; kind++ ) {
+        for ( s = 0; s < sizeof(gSizes) / sizeof(gSizes[0]); s++ ) {
+            if ( CheckBuffer( kind, file, gSizes[s], path ) != 0 ) {
+                printf( "FAIL: %s, %lu bytes, into a buffer\n",
+                        (kind == XRS_STREAM) ? "stream" : "VFS",
+                        (unsigned long)gSizes[s] );
+                failed++;
+            }
+            if ( CheckSend( kind, file, gSizes[s], path ) != 0 ) {
+                printf( "FAIL: %s, %lu bytes, sent\n",
+                        (kind == XRS_STREAM) ? "stream" : "VFS",
+                        (unsigned long)gSizes[s] );
+                failed++;
+            }
+        }
+    }
+
+    unlink( path );
+    HTTPLibStop();
+
+    printf( "media: %d failed\n", failed );
+    return (failed != 0);
+}
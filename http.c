@@ -42,9 +42,9 @@ Err errno;
 #define HTTP_HOST_HDR "Host: "
 #define HTTP_CONTENTLENGTH_HDR "Content-Length: "
 #define HTTP_LINE_ENDING "\r\n"
-#define HTTP_CONTENTTYPE_LINE "Content-Type: text/xml" ## HTTP_LINE_ENDING
+#define HTTP_CONTENTTYPE_LINE "Content-Type: text/xml" HTTP_LINE_ENDING
 #define HTTP_USERAGENT_LINE \
-        "User-Agent: PalmHTTP/0.1-PalmOS" ## HTTP_LINE_ENDING
+        "User-Agent: PalmHTTP/0.1-PalmOS" HTTP_LINE_ENDING
 
 #define HTTPLIB_TYPE 'TEMP'
 #define HTTPLIB_NAME "HTTPLib_Scratch_Area"
@@ -52,6 +52,9 @@ Err errno;
 /* Size of strings used to hold ascii conversion of numbers */
 #define CLS_LENGTH (11)
 
+/* Largest count handed to a single transport send */
+#define MAX_NET_WRITE (0x7FFF)
+
 
 /*
  * Used to represent the different stages of processing an HTTP response (the
@@ -78,16 +81,31 @@ typedef enum ParseState_enum {
  * keep the bufferPos field in sync with the readBuffer.  endOfStream is used
  * to hold the end of file result from the socket.  If we don't have a 
  * content length header we have to rely on hitting the end of the stream to 
- * tell us how much data there is.
+ * tell us how much data there is.  The body isn't written to the results 
+ * file as it comes in, it's staged in writeBlock and saved a whole block at
+ * a time (see BodyWrite()).  If there's a watch function it gets each piece
+ * of the body instead and can end the parse early.  Nothing reads the body
+ * back after a watcher has had it, so then it isn't saved at all and fd
+ * stays NULL.
  */
 
 #define READ_BUF_SIZE (2048)
 
+/* Default size of the block the response body is staged in before saving */
+#define WRITE_BLOCK_SIZE (4096)
+
 typedef struct HTTPParse_struct {
     ParseState state;
+    HTTPTransport *transport;
+    Int32 timeout;
     unsigned int responseCode;
     char *saveFileName;
+    HTTPWatchFunc watch;
+    void *watchCtx;
     void *fd;
+    char *writeBlock;
+    UInt16 writeBlockSize;
+    UInt16 writeFill;
     unsigned long contentLength;
     unsigned long contentRead;
     Int8 endOfStream;
@@ -100,49 +118,135 @@ typedef struct HTTPParse_struct {
 /*
  * There are still some servers that behave poorly on certain combinations of
  * valid network operations (if you don't feed them enough data for them to 
- * get what they want in a single network read).  Since it's also slightly more
- * efficient to form the image of the headers and send them in larger network
- * writes, we use a scratch record in a database to accumulate the request line
- * and headers and then send off the whole thing.  The struct has n error flag
- * field that's used to short circuit requests, so that we can just push data 
- * in without checking to see what the status is.  And then at the end we 
- * check once to see if the whole batch was successful.
+ * get what they want in a single network read).  It's also a lot more
+ * efficient to send full segments: a small request sent as headers and then
+ * body goes out as two packets, and with delayed ACKs on the server side the
+ * second one can sit for a whole round trip.  So everything sent goes
+ * through a send window about one segment in size.  The request line,
+ * headers and body are packed into it and it's only handed to the transport
+ * when it fills up or the request is complete, so a small request goes out
+ * in one write and a large one in full sized segments.  The struct has an
+ * error flag field that's used to short circuit requests, so that we can
+ * just push data in without checking to see what the status is.  And then
+ * at the end we check once to see if the whole batch was successful.
+ * 'total' counts every byte written, so a streamed body can be checked
+ * against the length it promised.
  */
 
-typedef struct ScratchRec_struct {
-    MemHandle handle;
-    UInt16 index;
-    UInt16 size;
+#define SEND_WINDOW_SIZE (1460)
+
+struct HTTPWindow_struct {
+    HTTPTransport *transport;
+    Int32 timeout;
+    char *buffer;
+    UInt16 fill;
+    UInt32 total;
     UInt8 errFlag;
-} ScratchRec;
+};
+
+
+/*
+ * What we've learned about the connection to each host.  One of these is
+ * kept per host and port as a record in the library database, so the 
+ * estimates carry over between runs.  srtt and rttvar are the smoothed round
+ * trip and its mean deviation in ticks, kept scaled up by 8 and 4 in the 
+ * usual TCP way so the averaging can be done with shifts.  The round trip 
+ * is measured from the end of the request to the first byte of the 
+ * response, so it includes the time the server takes to think.  rate is the
+ * smoothed receive rate in bytes per second, 0 until a response big enough 
+ * to measure has been seen.  failures counts the requests in a row that
+ * didn't get through, and lastUsed is when the record was last saved, in
+ * seconds, so the stalest host can be dropped when there are too many.
+ */
+
+#define HQ_HOST_LEN (64)
+
+typedef struct HostQuality_struct {
+    char host[HQ_HOST_LEN];
+    UInt16 port;
+    UInt16 samples;
+    UInt32 srtt;
+    UInt32 rttvar;
+    UInt32 rate;
+    UInt16 failures;
+    UInt32 lastUsed;
+} HostQuality;
+
+/* Most hosts to keep records for */
+#define HQ_MAX_HOSTS (8)
+
+/* Failures in a row before a host's estimates are thrown away */
+#define HQ_MAX_FAILURES (3)
+
+/* Limits on the timeouts derived from the estimates, in seconds */
+#define MIN_TIMEOUT (5)
+#define MAX_TIMEOUT (300)
+
+/* Smallest response that's used to estimate the receive rate */
+#define MIN_RATE_SAMPLE (1024)
 
 
 /*
  * Local prototypes (private to this file)
  */
 
-/* Temp scratch area */
-static int StartScratchArea( ScratchRec *scratch );
-static void AddToScratch( ScratchRec *scratch, char *text, int length );
-#define AddScratchLine( scratch, text ) \
-          AddToScratch( scratch, text, StrLen( text ) )
+/* Send window */
+static int WindowStart( HTTPWindow *win, HTTPTransport *transport,
+                        Int32 timeout );
+static void WindowWrite( HTTPWindow *win, char *data, UInt32 length );
+#define WindowWriteStr( win, text ) \
+          WindowWrite( win, text, StrLen( text ) )
+static void WindowFlush( HTTPWindow *win );
+static void WindowEnd( HTTPWindow *win );
+static void StartConnection( HTTPTransport *transport );
 
 /* Parse read buffer handling */
 static UInt16 BufSizeRemaining( HTTPParse *parse );
 static void BufConsumeToPointer( HTTPParse *parse, char *newFirst );
 static char *NextBufByte( HTTPParse *parse );
-static int FillReadBuff( NetSocketRef sock, HTTPParse *parse );
+static int FillReadBuff( HTTPParse *parse );
 
 /* Parse functions */
 static int MarkEOL( HTTPParse *parse );
 static char *ParseResponseCode( char *start );
-static void ParseEngine( NetSocketRef sock, HTTPParse *parse );
+static void ParseEngine( HTTPParse *parse );
 static void ParseResponseLine( HTTPParse *parse );
 static void ParseHeaders( HTTPParse *parse );
 static void ParseBody( HTTPParse *parse );
 
+/* Results file output */
+static int BodyOpen( HTTPParse *parse );
+static int BodyWrite( HTTPParse *parse, char *data, UInt16 length );
+static int BodyFlush( HTTPParse *parse );
+static void BodyClose( HTTPParse *parse );
+static int StorageWrite( HTTPParse *parse, char *data, UInt16 length );
+
 /* Network cover */
-int SendAll( NetSocketRef sock, char *data, UInt32 length );
+static int SendAll( HTTPTransport *transport, char *data, UInt32 length,
+                    Int32 timeout );
+static void StatsStart( HTTPTransport *transport );
+static void StatsSent( HTTPTransport *transport );
+static void StatsFinish( HTTPTransport *transport );
+
+/* Connection quality */
+static void QualityLoad( URLTarget *url, HostQuality *quality );
+static void QualitySave( HostQuality *quality );
+static void QualityUpdate( HostQuality *quality );
+static void QualityFailed( HostQuality *quality );
+static void QualityTrim( UInt16 keep );
+static Int32 QualityTimeout( HostQuality *quality, UInt32 bytes );
+
+/* Plain string bodies */
+static void StringBodyWrite( void *ctx, HTTPWindow *window );
+
+/* Default socket transport */
+static Int16 SockOpen( void *ctx, URLTarget *url, Int32 timeout );
+static Int16 SockSend( void *ctx, char *data, UInt16 length, Int32 timeout );
+static Int16 SockRecv( void *ctx, char *buffer, UInt16 length, 
+                       Int32 timeout );
+static void SockClose( void *ctx );
+static UInt32 SockTicks( void *ctx );
+static void SockNoDelay( void *ctx, Boolean on );
 
 
 /*
@@ -151,6 +255,18 @@ int SendAll( NetSocketRef sock, char *data, UInt32 length );
 
 static DmOpenRef gHttpLib = NULL;
 static int gTimeout = 0;
+static UInt16 gWriteBlockSize = WRITE_BLOCK_SIZE;
+static Boolean gNoDelay = true;
+
+static NetSocketRef gSock;
+static HTTPTransport gSockTransport = {
+    SockOpen, SockSend, SockRecv, SockClose, SockTicks, SockNoDelay, &gSock
+};
+static HTTPTransport *gTransport = &gSockTransport;
+
+static HTTPStats gStats;
+static UInt32 gStatsStart;
+static UInt32 gStatsSent;
 
 
 /*
@@ -158,16 +274,21 @@ static int gTimeout = 0;
  * Args:   creator - creator ID to use for the database
  *         secTimeout - number of seconds to allow for server response
  * Return: 0 on success, -1 on error
- * Desc:   Creates the temp database used by the library.  I haven't registered
+ * Desc:   Creates the database used by the library.  I haven't registered
  *         a creator ID for the library itself, so the calling app should pass
  *         it's own creator ID and this function will create a database under
- *         that ID.
+ *         that ID.  The database holds the connection quality records, 
+ *         anything else in there is left over from older versions that used
+ *         it as a scratch area and gets cleared out, and only the
+ *         HQ_MAX_HOSTS most recently used hosts are kept.  'secTimeout' is
+ *         used for hosts we don't know anything about yet, and as the
+ *         shortest timeout for the ones we do.
  */
 
 int HTTPLibStart( UInt32 creator, int secTimeout )
 {
     Err error;
-    int recs;
+    MemHandle handle;
     int i;
 
     gHttpLib = DmOpenDatabaseByTypeCreator( HTTPLIB_TYPE, creator,
@@ -185,10 +306,17 @@ int HTTPLibStart( UInt32 creator, int secTimeout )
             return -2;
         }
     } else {
-        recs = DmNumRecords( gHttpLib );
-        for ( i = 0; i < recs; i++ ) {
-            DmRemoveRecord( gHttpLib, 0 );
+        i = 0;
+        while ( i < DmNumRecords( gHttpLib ) ) {
+            handle = DmQueryRecord( gHttpLib, i );
+            if ( (handle == NULL) ||
+                    (MemHandleSize( handle ) != sizeof(HostQuality)) ) {
+                DmRemoveRecord( gHttpLib, i );
+            } else {
+                i++;
+            }
         }
+        QualityTrim( HQ_MAX_HOSTS );
     }
 
     gTimeout = secTimeout;
@@ -201,26 +329,86 @@ int HTTPLibStart( UInt32 creator, int secTimeout )
  * Name:   HTTPLibStop()
  * Args:   none
  * Return: none
- * Desc:   Attempts to free up the temporary storage database records and
- *         shut the open database.
+ * Desc:   Shuts the library database.  The connection quality records are
+ *         kept for next time.
  */
 
 void HTTPLibStop( void )
 {
-    int recs;
-    int i;
-
     if ( gHttpLib != NULL ) {
-        recs = DmNumRecords( gHttpLib );
-        for ( i = 0; i < recs; i++ ) {
-            DmRemoveRecord( gHttpLib, 0 );
-        }
         DmCloseDatabase( gHttpLib );
         gHttpLib = NULL;
     }
 }
 
 
+/*
+ * Name:   HTTPLibSetTransport()
+ * Args:   transport - network operations to use, NULL for the default
+ * Return: none
+ * Desc:   Replaces the set of network operations used for all following
+ *         requests.  Passing NULL goes back to the NetLib socket transport.
+ *         The struct isn't copied, so it has to stay valid until it's
+ *         replaced.
+ */
+
+void HTTPLibSetTransport( HTTPTransport *transport )
+{
+    if ( transport == NULL ) {
+        gTransport = &gSockTransport;
+    } else {
+        gTransport = transport;
+    }
+}
+
+
+/*
+ * Name:   HTTPLibSetWriteBlock()
+ * Args:   size - bytes of response body to collect before each save
+ * Return: none
+ * Desc:   Sets the size of the staging block used while saving response
+ *         bodies.  Each save into the results stream costs a trip through
+ *         the storage heap, so bigger blocks mean fewer of them at the 
+ *         expense of dynamic heap.  A size of 0 turns staging off and every
+ *         read gets written straight through.
+ */
+
+void HTTPLibSetWriteBlock( UInt16 size )
+{
+    gWriteBlockSize = size;
+}
+
+
+/*
+ * Name:   HTTPLibSetNoDelay()
+ * Args:   on - true to turn the Nagle algorithm off for new connections
+ * Return: none
+ * Desc:   The send window already packs requests into full segments, so by
+ *         default Nagle is turned off (TCP_NODELAY) to keep the last partial
+ *         segment of a request from waiting on the ACK for the one before
+ *         it.  Only has an effect if the transport supports it.
+ */
+
+void HTTPLibSetNoDelay( Boolean on )
+{
+    gNoDelay = on;
+}
+
+
+/*
+ * Name:   HTTPLibGetStats()
+ * Args:   stats - struct to fill in
+ * Return: none
+ * Desc:   Copies out the byte counts and timings from the most recent
+ *         request.
+ */
+
+void HTTPLibGetStats( HTTPStats *stats )
+{
+    MemMove( stats, &gStats, sizeof(HTTPStats) );
+}
+
+
 /*
  * This was ripped from GNU GotMail, it's the method it uses for connecting a
  * socket instead of NetUTCPOpen().  The Palm docs say that NetUTCPOpen() is
@@ -289,292 +477,1044 @@ int connectsock(char *host, char *service)
     return sock;
 }
 
-#endif /* 0 */
+#endif /* 0 */
+
+
+/*
+ * Name:   HTTPPost()
+ * Args:   url - location to post data to
+ *         data - text to send in the post body (currently must be a string)
+ *         resultsDB - name of the stream DB to save the response into
+ * Return: HTTPErr_OK on success, != HTTPErr_OK on all errors
+ * Desc:   Sends the data passed in as the body of a POST request against the
+ *         host/port/path specified in 'url'.  If the request is successfull,
+ *         the response text is saved in a stream database with the name given
+ *         in 'resultsDB'.
+ */
+
+HTTPErr HTTPPost( URLTarget *url, char *data, char *resultsDB )
+{
+    return HTTPPostWatch( url, data, resultsDB, NULL, NULL );
+}
+
+
+/*
+ * Name:   HTTPPostWatch()
+ * Args:   url - location to post data to
+ *         data - text to send in the post body (currently must be a string)
+ *         resultsDB - name of the stream DB to save the response into,
+ *                     not used if there's a watch function
+ *         watch - function to look at the response body as it arrives, 
+ *                 or NULL
+ *         watchCtx - passed through to 'watch'
+ * Return: HTTPErr_OK on success, != HTTPErr_OK on all errors
+ * Desc:   Same as HTTPPost(), but 'watch' is called with each piece of the
+ *         response body as it's read, and the body isn't saved.  If it
+ *         returns true we stop reading and close the connection (we only
+ *         speak HTTP/1.0 without keep alive, so there's no point draining
+ *         what's left).
+ */
+
+HTTPErr HTTPPostWatch( URLTarget *url, char *data, char *resultsDB,
+                       HTTPWatchFunc watch, void *watchCtx )
+{
+    HTTPBody body;
+
+    body.length = StrLen( data );
+    body.write = StringBodyWrite;
+    body.ctx = data;
+
+    return HTTPPostBody( url, &body, resultsDB, watch, watchCtx );
+}
+
+
+/*
+ * Name:   StringBodyWrite()
+ * Args:   ctx - the string to send
+ *         window - send window to write into
+ * Return: none
+ * Desc:   HTTPBodyFunc used by HTTPPostWatch() to send a plain string.
+ */
+
+static void StringBodyWrite( void *ctx, HTTPWindow *window )
+{
+    char *data;
+
+    data = (char *)ctx;
+    WindowWrite( window, data, StrLen( data ) );
+}
+
+
+/*
+ * Name:   HTTPPostBody()
+ * Args:   url - location to post data to
+ *         body - describes the request body and how to produce it
+ *         resultsDB - name of the stream DB to save the response into,
+ *                     not used if there's a watch function
+ *         watch - function to look at the response body as it arrives, 
+ *                 or NULL
+ *         watchCtx - passed through to 'watch'
+ * Return: HTTPErr_OK on success, != HTTPErr_OK on all errors
+ * Desc:   Same as HTTPPostWatch(), but the request body is written into the
+ *         send window by 'body->write' as the request goes out, so the
+ *         caller never needs the whole body in memory.  If the body writes
+ *         a different number of bytes than it said it would the request is
+ *         treated as a connect error, the server would have misread it.
+ */
+
+HTTPErr HTTPPostBody( URLTarget *url, HTTPBody *body, char *resultsDB,
+                      HTTPWatchFunc watch, void *watchCtx )
+{
+    char contentLenStr[CLS_LENGTH];
+    UInt32 headerLength;
+    Int32 timeout;
+    HTTPParse parse;
+    HTTPWindow win;
+    HostQuality quality;
+
+    QualityLoad( url, &quality );
+    timeout = QualityTimeout( &quality, body->length + READ_BUF_SIZE );
+
+    StatsStart( gTransport );
+
+    if ( gTransport->openConn( gTransport->ctx, url, timeout ) != 0 ) {
+        QualityFailed( &quality );
+        return HTTPErr_ConnectError;
+    }
+    StartConnection( gTransport );
+
+    if ( WindowStart( &win, gTransport, timeout ) != 0 ) {
+        gTransport->closeConn( gTransport->ctx );
+        return HTTPErr_NoMemory;
+    }
+
+    WindowWriteStr( &win, HTTP_POST_METH );
+    WindowWriteStr( &win, url->path );
+    WindowWriteStr( &win, HTTP_VERSION );
+    WindowWriteStr( &win, HTTP_LINE_ENDING );
+    WindowWriteStr( &win, HTTP_HOST_HDR );
+    WindowWriteStr( &win, url->host );
+    WindowWriteStr( &win, HTTP_LINE_ENDING );
+    WindowWriteStr( &win, HTTP_USERAGENT_LINE );
+    WindowWriteStr( &win, HTTP_CONTENTTYPE_LINE );
+    WindowWriteStr( &win, HTTP_CONTENTLENGTH_HDR );
+    StrPrintF( contentLenStr, "%ld", body->length );
+    contentLenStr[CLS_LENGTH - 1] = '\0';
+    WindowWriteStr( &win, contentLenStr );
+    WindowWriteStr( &win, HTTP_LINE_ENDING );
+    WindowWriteStr( &win, HTTP_LINE_ENDING );
+    headerLength = win.total;
+    body->write( body->ctx, &win );
+    WindowFlush( &win );
+    WindowEnd( &win );
+    StatsSent( gTransport );
+
+    if ( win.errFlag || ((win.total - headerLength) != body->length) ) {
+        gTransport->closeConn( gTransport->ctx );
+        if ( win.errFlag ) {
+            QualityFailed( &quality );
+        }
+        return HTTPErr_ConnectError;
+    }
+
+    MemSet( &parse, sizeof( parse ), 0 );
+    parse.state = PS_ResponseLine;
+    parse.transport = gTransport;
+    parse.timeout = timeout;
+    parse.saveFileName = resultsDB;
+    parse.watch = watch;
+    parse.watchCtx = watchCtx;
+
+    ParseEngine( &parse );
+    BodyClose( &parse );
+
+    gTransport->closeConn( gTransport->ctx );
+    StatsFinish( gTransport );
+
+    if ( parse.state != PS_Done ) {
+        QualityFailed( &quality );
+        return HTTPErr_SizeMismatch;
+    }
+
+    QualityUpdate( &quality );
+    QualitySave( &quality );
+
+    return HTTPErr_OK;
+}
+
+
+/*
+ * Name:   HTTPGet()
+ * Args:   url - location to fetch from
+ *         resultsDB - name of the stream DB to save the response into
+ * Return: HTTPErr_OK on success, != HTTPErr_OK on all errors
+ * Desc:   Attempts to read the data from the URL specified and writes the
+ *         body into a stream database names 'resultsDB'.
+ */
+
+HTTPErr HTTPGet( URLTarget *url, char *resultsDB )
+{
+    Int32 timeout;
+    HTTPParse parse;
+    HTTPWindow win;
+    HostQuality quality;
+
+    QualityLoad( url, &quality );
+    timeout = QualityTimeout( &quality, READ_BUF_SIZE );
+
+    StatsStart( gTransport );
+
+    if ( gTransport->openConn( gTransport->ctx, url, timeout ) != 0 ) {
+        QualityFailed( &quality );
+        return HTTPErr_ConnectError;
+    }
+    StartConnection( gTransport );
+
+    if ( WindowStart( &win, gTransport, timeout ) != 0 ) {
+        gTransport->closeConn( gTransport->ctx );
+        return HTTPErr_NoMemory;
+    }
+
+    WindowWriteStr( &win, HTTP_GET_METH );
+    WindowWriteStr( &win, url->path );
+    WindowWriteStr( &win, HTTP_VERSION );
+    WindowWriteStr( &win, HTTP_LINE_ENDING );
+    WindowWriteStr( &win, HTTP_HOST_HDR );
+    WindowWriteStr( &win, url->host );
+    WindowWriteStr( &win, HTTP_LINE_ENDING );
+    WindowWriteStr( &win, HTTP_USERAGENT_LINE );
+    WindowWriteStr( &win, HTTP_LINE_ENDING );
+    WindowFlush( &win );
+    WindowEnd( &win );
+    StatsSent( gTransport );
+
+    if ( win.errFlag ) {
+        gTransport->closeConn( gTransport->ctx );
+        QualityFailed( &quality );
+        return HTTPErr_ConnectError;
+    }
+
+    MemSet( &parse, sizeof( parse ), 0 );
+    parse.state = PS_ResponseLine;
+    parse.transport = gTransport;
+    parse.timeout = timeout;
+    parse.saveFileName = resultsDB;
+
+    ParseEngine( &parse );
+    BodyClose( &parse );
+
+    gTransport->closeConn( gTransport->ctx );
+    StatsFinish( gTransport );
+
+    if ( parse.state != PS_Done ) {
+        QualityFailed( &quality );
+        return HTTPErr_SizeMismatch;
+    }
+
+    QualityUpdate( &quality );
+    QualitySave( &quality );
+
+    return HTTPErr_OK;
+}
+
+
+/*
+ * Span searching.  Words are only read once they're lined up on a 4 byte
+ * boundary, since the 68000 can't read a long from an odd address, and
+ * never past 'end'.  SPAN_HAS_ZERO() is non-zero if any byte of the word
+ * is 0, so XORing with the byte wanted in every position finds it.
+ */
+
+#define SPAN_ONES ((UInt32)0x01010101)
+#define SPAN_HIGHS ((UInt32)0x80808080)
+#define SPAN_HAS_ZERO( w ) (((w) - SPAN_ONES) & ~(w) & SPAN_HIGHS)
+
+
+/*
+ * Name:   HTTPSpanChr()
+ * Args:   start - first byte to look at
+ *         end - just past the last byte to look at
+ *         ch - the byte to look for
+ * Return: pointer to the first 'ch', or NULL if there isn't one
+ */
+
+const char *HTTPSpanChr( const char *start, const char *end, char ch )
+{
+    const UInt32 *word;
+    UInt32 pattern;
+
+    while ( (start < end) && ((((unsigned long)start) & 3) != 0) ) {
+        if ( *start == ch ) {
+            return start;
+        }
+        start++;
+    }
+
+    pattern = (UInt8)ch * SPAN_ONES;
+    word = (const UInt32 *)start;
+    while ( ((const char *)(word + 1) <= end) && 
+            !SPAN_HAS_ZERO( *word ^ pattern ) ) {
+        word++;
+    }
+
+    start = (const char *)word;
+    while ( start < end ) {
+        if ( *start == ch ) {
+            return start;
+        }
+        start++;
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Name:   HTTPSearchInit()
+ * Args:   search - searcher to set up
+ *         needle - what it looks for, which has to stay put while the
+ *                  searcher is in use
+ * Return: none
+ * Desc:   Works out how far the search can skip ahead for each byte value
+ *         when it doesn't match.  Needles longer than HTTP_SEARCH_MAX are
+ *         cut off.
+ */
+
+void HTTPSearchInit( HTTPSearch *search, const char *needle )
+{
+    UInt16 length;
+    UInt16 i;
+
+    length = StrLen( needle );
+    if ( length > HTTP_SEARCH_MAX ) {
+        length = HTTP_SEARCH_MAX;
+    }
+
+    search->needle = needle;
+    search->length = (UInt8)length;
+    MemSet( search->shift, sizeof( search->shift ), (UInt8)length );
+    for ( i = 0; (i + 1) < length; i++ ) {
+        search->shift[(UInt8)needle[i]] = (UInt8)(length - 1 - i);
+    }
+}
+
+
+/*
+ * Name:   HTTPSearchSpan()
+ * Args:   search - a searcher set up with HTTPSearchInit()
+ *         start - first byte to look at
+ *         end - just past the last byte to look at
+ * Return: pointer to the start of the first match, or NULL if there isn't
+ *         one
+ * Desc:   A single byte needle goes to HTTPSpanChr().  Otherwise the span
+ *         is checked against the needle from its last byte back, and
+ *         moved along by the skip for the byte under the needle's end.
+ */
+
+const char *HTTPSearchSpan( const HTTPSearch *search, const char *start,
+                            const char *end )
+{
+    const char *last;
+    const char *needle;
+    UInt16 length;
+    UInt16 i;
+
+    length = search->length;
+    needle = search->needle;
+    if ( length == 0 ) {
+        return start;
+    }
+    if ( length == 1 ) {
+        return HTTPSpanChr( start, end, needle[0] );
+    }
+    if ( (end - start) < length ) {
+        return NULL;
+    }
+
+    last = start + (length - 1);
+    while ( last < end ) {
+        if ( *last == needle[length - 1] ) {
+            i = length - 1;
+            while ( (i > 0) && (last[(Int16)i - (Int16)length] ==
+                                needle[i - 1]) ) {
+                i--;
+            }
+            if ( i == 0 ) {
+                return last - (length - 1);
+            }
+        }
+        last += search->shift[(UInt8)*last];
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Name:   HTTPSearchTail()
+ * Args:   search - a searcher set up with HTTPSearchInit()
+ *         start - first byte of a span with no match in it
+ *         end - just past the last byte of the span
+ * Return: the number of bytes at the end of the span that match the start
+ *         of the needle, 0 to length - 1
+ */
+
+UInt16 HTTPSearchTail( const HTTPSearch *search, const char *start,
+                       const char *end )
+{
+    UInt16 tail;
+
+    tail = search->length - 1;
+    if ( (end - start) < tail ) {
+        tail = end - start;
+    }
+
+    while ( tail > 0 ) {
+        if ( MemCmp( end - tail, search->needle, tail ) == 0 ) {
+            break;
+        }
+        tail--;
+    }
+
+    return tail;
+}
+
+
+/*
+ * Name:   StartConnection()
+ * Args:   transport - the freshly opened transport
+ * Return: none
+ * Desc:   Applies the per connection options.
+ */
+
+static void StartConnection( HTTPTransport *transport )
+{
+    if ( transport->nodelay != NULL ) {
+        transport->nodelay( transport->ctx, gNoDelay );
+    }
+}
+
+
+/*
+ * Name:   WindowStart()
+ * Args:   win - send window to set up
+ *         transport - where the window gets sent
+ *         timeout - ticks to allow for each network write
+ * Return: 0 on success, -1 on error
+ * Desc:   Allocates the window buffer and starts it out empty.
+ */
+
+static int WindowStart( HTTPWindow *win, HTTPTransport *transport,
+                        Int32 timeout )
+{
+    win->transport = transport;
+    win->timeout = timeout;
+    win->fill = 0;
+    win->total = 0;
+    win->errFlag = 0;
+
+    win->buffer = (char *)MemPtrNew( SEND_WINDOW_SIZE );
+    if ( win->buffer == NULL ) {
+        win->errFlag = 1;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   WindowWrite()
+ * Args:   win - send window to add to
+ *         data - pointer to the data to add
+ *         length - number of bytes to add from the start of 'data'
+ * Return: none
+ * Desc:   Adds 'length' bytes to the window, sending a full window each time
+ *         it fills.  When the window is empty and there's at least a full
+ *         window's worth of data, the whole segments are sent straight from
+ *         'data' and only the tail is copied.  No status is returned 
+ *         directly, on error a flag is set in the 'win' struct instead.  
+ *         There's a cover, WindowWriteStr(), which can be used to add a null
+ *         terminated character string without having to clutter up the calls
+ *         with lots of StrLen() calls for the final arg.
+ */
+
+static void WindowWrite( HTTPWindow *win, char *data, UInt32 length )
+{
+    UInt32 count;
+
+    win->total += length;
+    while ( (length > 0) && !win->errFlag ) {
+        if ( (win->fill == 0) && (length >= SEND_WINDOW_SIZE) ) {
+            count = length - (length % SEND_WINDOW_SIZE);
+            if ( SendAll( win->transport, data, count, win->timeout ) != 0 ) {
+                win->errFlag = 1;
+            }
+        } else {
+            count = SEND_WINDOW_SIZE - win->fill;
+            if ( count > length ) {
+                count = length;
+            }
+            MemMove( win->buffer + win->fill, data, count );
+            win->fill += count;
+            if ( win->fill == SEND_WINDOW_SIZE ) {
+                WindowFlush( win );
+            }
+        }
+
+        data += count;
+        length -= count;
+    }
+}
+
+
+/*
+ * Name:   HTTPWindowWrite()
+ * Args:   window - send window passed to an HTTPBodyFunc
+ *         data - pointer to the data to add
+ *         length - number of bytes to add from the start of 'data'
+ * Return: none
+ * Desc:   Lets a streamed request body add data to the send window.  Errors
+ *         are picked up by HTTPPostBody() once the body is complete.
+ */
+
+void HTTPWindowWrite( HTTPWindow *window, const char *data, UInt32 length )
+{
+    WindowWrite( window, (char *)data, length );
+}
+
+
+/*
+ * Name:   WindowFlush()
+ * Args:   win - send window to send
+ * Return: none
+ * Desc:   Sends whatever is in the window and empties it.
+ */
+
+static void WindowFlush( HTTPWindow *win )
+{
+    if ( win->errFlag || (win->fill == 0) ) {
+        return;
+    }
+
+    if ( SendAll( win->transport, win->buffer, win->fill, 
+                  win->timeout ) != 0 ) {
+        win->errFlag = 1;
+    }
+    win->fill = 0;
+}
+
+
+/*
+ * Name:   WindowEnd()
+ * Args:   win - send window to release
+ * Return: none
+ * Desc:   Frees the window buffer.  Anything not flushed is dropped.
+ */
+
+static void WindowEnd( HTTPWindow *win )
+{
+    if ( win->buffer != NULL ) {
+        MemPtrFree( win->buffer );
+        win->buffer = NULL;
+    }
+}
+
+
+/*
+ * Name:   SendAll()
+ * Args:   transport - transport to send over
+ *         data - the bytes to send
+ *         length - the number of bytes to send
+ *         timeout - ticks to allow for each network write
+ * Return: 0 on success, -1 on error
+ * Desc:   Sends exactly 'length' bytes over 'transport'.  If unable to 
+ *         send the full set of data, it is considered an error.  Writes are
+ *         broken up so that no single call asks for more than a signed 16
+ *         bit count.
+ */
+
+static int SendAll( HTTPTransport *transport, char *data, UInt32 length,
+                    Int32 timeout )
+{
+    UInt32 written;
+    UInt32 thisLength;
+    Int16 thisWrite;
+
+    written = 0;
+
+    while ( written < length ) {
+        thisLength = length - written;
+        if ( thisLength > MAX_NET_WRITE ) {
+            thisLength = MAX_NET_WRITE;
+        }
+        thisWrite = transport->sendData( transport->ctx, &(data[written]),
+                                         thisLength, timeout );
+        if ( thisWrite <= 0 ) {
+            return -1;
+        }
+        written += thisWrite;
+        gStats.bytesSent += thisWrite;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   StatsStart()
+ * Args:   transport - transport whose clock is used for the timings
+ * Return: none
+ * Desc:   Clears the counters kept for HTTPLibGetStats() and notes the 
+ *         starting time of the request.
+ */
+
+static void StatsStart( HTTPTransport *transport )
+{
+    MemSet( &gStats, sizeof(gStats), 0 );
+    gStatsStart = transport->ticks( transport->ctx );
+}
+
+
+/*
+ * Name:   StatsSent()
+ * Args:   transport - transport whose clock is used for the timings
+ * Return: none
+ * Desc:   Notes the time the last byte of the request went out, the round
+ *         trip sample is measured from here.
+ */
+
+static void StatsSent( HTTPTransport *transport )
+{
+    gStatsSent = transport->ticks( transport->ctx );
+}
+
+
+/*
+ * Name:   StatsFinish()
+ * Args:   transport - transport whose clock is used for the timings
+ * Return: none
+ * Desc:   Records the total time taken by the request.
+ */
+
+static void StatsFinish( HTTPTransport *transport )
+{
+    gStats.totalTicks = transport->ticks( transport->ctx ) - gStatsStart;
+}
+
+
+/*
+ * Name:   QualityLoad()
+ * Args:   url - host and port to look up
+ *         quality - struct to fill in
+ * Return: none
+ * Desc:   Copies out the saved connection quality record for the host.  If
+ *         there isn't one 'quality' is set up as a new record with no 
+ *         samples.
+ */
+
+static void QualityLoad( URLTarget *url, HostQuality *quality )
+{
+    UInt16 recs;
+    UInt16 i;
+    MemHandle handle;
+    HostQuality *rec;
+
+    MemSet( quality, sizeof(HostQuality), 0 );
+    StrNCopy( quality->host, url->host, HQ_HOST_LEN - 1 );
+    quality->port = url->port;
+
+    if ( gHttpLib == NULL ) {
+        return;
+    }
+
+    recs = DmNumRecords( gHttpLib );
+    for ( i = 0; i < recs; i++ ) {
+        handle = DmQueryRecord( gHttpLib, i );
+        if ( handle == NULL ) {
+            continue;
+        }
+        rec = (HostQuality *)MemHandleLock( handle );
+        if ( (rec->port == quality->port) &&
+                (StrCompare( rec->host, quality->host ) == 0) ) {
+            MemMove( quality, rec, sizeof(HostQuality) );
+            MemHandleUnlock( handle );
+            return;
+        }
+        MemHandleUnlock( handle );
+    }
+}
+
+
+/*
+ * Name:   QualitySave()
+ * Args:   quality - record to save
+ * Return: none
+ * Desc:   Writes the record back over the saved one for the same host, or
+ *         adds a new record if this is the first time we've seen it, making
+ *         room by dropping the least recently used host if need be.
+ *         Failures are ignored, we just lose the history.
+ */
+
+static void QualitySave( HostQuality *quality )
+{
+    UInt16 recs;
+    UInt16 index;
+    MemHandle handle;
+    HostQuality *rec;
+    Boolean found;
+
+    if ( gHttpLib == NULL ) {
+        return;
+    }
+    quality->lastUsed = TimGetSeconds();
+
+    found = false;
+    recs = DmNumRecords( gHttpLib );
+    for ( index = 0; (index < recs) && !found; index++ ) {
+        handle = DmQueryRecord( gHttpLib, index );
+        if ( handle == NULL ) {
+            continue;
+        }
+        rec = (HostQuality *)MemHandleLock( handle );
+        if ( (rec->port == quality->port) &&
+                (StrCompare( rec->host, quality->host ) == 0) ) {
+            found = true;
+        }
+        MemHandleUnlock( handle );
+    }
+
+    if ( found ) {
+        index--;
+        handle = DmGetRecord( gHttpLib, index );
+    } else {
+        QualityTrim( HQ_MAX_HOSTS - 1 );
+        index = dmMaxRecordIndex;
+        handle = DmNewRecord( gHttpLib, &index, sizeof(HostQuality) );
+    }
+    if ( handle == NULL ) {
+        return;
+    }
+
+    rec = (HostQuality *)MemHandleLock( handle );
+    DmWrite( rec, 0, quality, sizeof(HostQuality) );
+    MemHandleUnlock( handle );
+    DmReleaseRecord( gHttpLib, index, true );
+}
 
 
 /*
- * Name:   HTTPPost()
- * Args:   url - location to post data to
- *         data - text to send in the post body (currently must be a string)
- *         resultsDB - name of the stream DB to save the response into
- * Return: HTTPErr_OK on success, != HTTPErr_OK on all errors
- * Desc:   Sends the data passed in as the body of a POST request against the
- *         host/port/path specified in 'url'.  If the request is successfull,
- *         the response text is saved in a stream database with the name given
- *         in 'resultsDB'.
+ * Name:   QualityUpdate()
+ * Args:   quality - record to fold the last request into
+ * Return: none
+ * Desc:   Takes the round trip and receive rate from the request that just
+ *         finished and folds them into the running averages.  The round trip
+ *         uses the Jacobson/Karels estimator from TCP, the rate is a plain
+ *         1/8 weighted moving average.  Responses that are too small or too
+ *         quick to time aren't used for the rate.
  */
 
-HTTPErr HTTPPost( URLTarget *url, char *data, char *resultsDB )
+static void QualityUpdate( HostQuality *quality )
 {
-    NetSocketRef sock;
-    char contentLenStr[CLS_LENGTH];
-    UInt32 length;
-    Err err;
-    Err err2;
-    HTTPParse parse;
-    ScratchRec scratch;
-    char *headers;
-    UInt8 allup;
+    Int32 rtt;
+    Int32 delta;
+    UInt32 bytes;
+    UInt32 ticks;
+    UInt32 rate;
+
+    quality->failures = 0;
+    if ( gStats.bytesReceived == 0 ) {
+        return;
+    }
 
-    AppNetRefnum = 0;
+    rtt = (Int32)(gStats.firstByteTicks - (gStatsSent - gStatsStart));
+    if ( rtt < 1 ) {
+        rtt = 1;
+    }
 
-    err = SysLibFind( "Net.lib", &AppNetRefnum );
-    err = NetLibOpen( AppNetRefnum, &err2 );
-    if ( (err && (err != netErrAlreadyOpen)) || err2 ) {
-        NetLibClose( AppNetRefnum, true );
-        return HTTPErr_ConnectError;
+    if ( quality->samples == 0 ) {
+        quality->srtt = rtt << 3;
+        quality->rttvar = rtt << 1;
+    } else {
+        delta = rtt - (Int32)(quality->srtt >> 3);
+        quality->srtt += delta;
+        if ( delta < 0 ) {
+            delta = -delta;
+        }
+        quality->rttvar += delta - (Int32)(quality->rttvar >> 2);
     }
 
-    AppNetTimeout = SysTicksPerSecond() * gTimeout;
+    if ( quality->samples < 0xFFFF ) {
+        quality->samples++;
+    }
 
-    NetLibConnectionRefresh( AppNetRefnum, true, &allup, &err2 );
+    bytes = gStats.bytesReceived;
+    ticks = gStats.totalTicks - gStats.firstByteTicks;
+    if ( (bytes < MIN_RATE_SAMPLE) || (ticks == 0) ) {
+        return;
+    }
 
-    sock = NetUTCPOpen( url->host, NULL, url->port );
-    // sock = connectsock( url->host, "8080" );
-    if ( sock < 0 ) {
-        err = NetLibClose( AppNetRefnum, true );
-        return HTTPErr_ConnectError;
+    rate = (bytes / ticks) * SysTicksPerSecond() +
+           ((bytes % ticks) * SysTicksPerSecond()) / ticks;
+    if ( rate == 0 ) {
+        rate = 1;
     }
 
-    if ( StartScratchArea( &scratch ) != 0 ) {
-        close( sock );
-        err = NetLibClose( AppNetRefnum, true );
-        return HTTPErr_TempDBErr;
-    }
-
-    AddScratchLine( &scratch, HTTP_POST_METH );
-    AddScratchLine( &scratch, url->path );
-    AddScratchLine( &scratch, HTTP_VERSION );
-    AddScratchLine( &scratch, HTTP_LINE_ENDING );
-    AddScratchLine( &scratch, HTTP_HOST_HDR );
-    AddScratchLine( &scratch, url->host );
-    AddScratchLine( &scratch, HTTP_LINE_ENDING );
-    AddScratchLine( &scratch, HTTP_USERAGENT_LINE );
-    AddScratchLine( &scratch, HTTP_CONTENTTYPE_LINE );
-    AddScratchLine( &scratch, HTTP_CONTENTLENGTH_HDR );
-    length = StrLen( data );
-    StrPrintF( contentLenStr, "%ld", length );
-    contentLenStr[CLS_LENGTH - 1] = '\0';
-    AddScratchLine( &scratch, contentLenStr );
-    AddScratchLine( &scratch, HTTP_LINE_ENDING );
-    AddScratchLine( &scratch, HTTP_LINE_ENDING );
-   
-    if ( scratch.errFlag ) {
-        close( sock );
-        err = NetLibClose( AppNetRefnum, false );
-        return HTTPErr_TempDBErr;
+    if ( quality->rate == 0 ) {
+        quality->rate = rate;
+    } else {
+        quality->rate = quality->rate - (quality->rate >> 3) + (rate >> 3);
     }
+}
 
-    scratch.handle = DmQueryRecord( gHttpLib, scratch.index );
-    headers = MemHandleLock( scratch.handle );
-    SendAll( sock, headers, scratch.size );
-    MemHandleUnlock( scratch.handle );
 
-    SendAll( sock, data, length );
+/*
+ * Name:   QualityTimeout()
+ * Args:   quality - what we know about the host
+ *         bytes - amount of data expected to move in the request
+ * Return: timeout to use for each network operation, in ticks
+ * Desc:   With no history we fall back on the timeout the app gave us.
+ *         Otherwise the timeout is the TCP style retransmit estimate (the
+ *         smoothed round trip plus four deviations) plus twice the time 
+ *         'bytes' should take at the measured rate, clamped to a sane 
+ *         range.  So a fast link gives up quickly on a dead server, and a
+ *         slow one allows a big upload the time it actually needs.  The
+ *         app's timeout is the least that's ever allowed, since that's the
+ *         wait the user asked for.
+ */
 
-    MemSet( &parse, sizeof( parse ), 0 );
-    parse.state = PS_ResponseLine;
-    parse.saveFileName = resultsDB;
+static Int32 QualityTimeout( HostQuality *quality, UInt32 bytes )
+{
+    UInt32 tps;
+    UInt32 timeout;
 
-    ParseEngine( sock, &parse );
+    tps = SysTicksPerSecond();
 
-    close( sock );
-    NetLibClose( AppNetRefnum, false );
+    if ( quality->samples == 0 ) {
+        return tps * gTimeout;
+    }
 
-    if ( parse.state != PS_Done ) {
-        return HTTPErr_SizeMismatch;
+    timeout = (quality->srtt >> 3) + quality->rttvar;
+    if ( quality->rate != 0 ) {
+        timeout += 2 * ((bytes / quality->rate) * tps +
+                        ((bytes % quality->rate) * tps) / quality->rate);
     }
 
-    return HTTPErr_OK;
+    if ( timeout < (MIN_TIMEOUT * tps) ) {
+        timeout = MIN_TIMEOUT * tps;
+    } else if ( timeout > (MAX_TIMEOUT * tps) ) {
+        timeout = MAX_TIMEOUT * tps;
+    }
+    if ( timeout < (gTimeout * tps) ) {
+        timeout = gTimeout * tps;
+    }
+
+    return timeout;
 }
 
 
 /*
- * Name:   HTTPGet()
- * Args:   url - location to fetch from
- *         resultsDB - name of the stream DB to save the response into
- * Return: HTTPErr_OK on success, != HTTPErr_OK on all errors
- * Desc:   Attempts to read the data from the URL specified and writes the
- *         body into a stream database names 'resultsDB'.
+ * Name:   QualityFailed()
+ * Args:   quality - record for the host that didn't get through
+ * Return: none
+ * Desc:   Backs the timeout off the way TCP does after a retransmit
+ *         timeout, by doubling the deviation, so a link that's got slower
+ *         isn't cut off again at the same point.  After HQ_MAX_FAILURES in
+ *         a row the estimates are thrown away and the host goes back to
+ *         the app's timeout until it answers again.  Hosts with no history
+ *         already use the app's timeout and aren't saved.
  */
 
-HTTPErr HTTPGet( URLTarget *url, char *resultsDB )
+static void QualityFailed( HostQuality *quality )
 {
-    NetSocketRef sock;
-    Err err;
-    Err err2;
-    HTTPParse parse;
-    ScratchRec scratch;
-    char *headers;
+    UInt32 limit;
 
-    AppNetRefnum = 0;
-
-    err = SysLibFind( "Net.lib", &AppNetRefnum );
-    err = NetLibOpen( AppNetRefnum, &err2 );
-
-    sock = NetUTCPOpen( url->host, NULL, url->port );
-    if ( sock < 0 ) {
-        err = NetLibClose( AppNetRefnum, false );
-        return HTTPErr_ConnectError;
+    if ( quality->samples == 0 ) {
+        return;
     }
 
-    if ( StartScratchArea( &scratch ) != 0 ) {
-        close( sock );
-        err = NetLibClose( AppNetRefnum, false );
-        return HTTPErr_TempDBErr;
+    quality->failures++;
+    if ( quality->failures >= HQ_MAX_FAILURES ) {
+        quality->samples = 0;
+        quality->srtt = 0;
+        quality->rttvar = 0;
+        quality->rate = 0;
+        quality->failures = 0;
+    } else {
+        limit = MAX_TIMEOUT * SysTicksPerSecond();
+        if ( quality->rttvar > (limit >> 1) ) {
+            quality->rttvar = limit;
+        } else {
+            quality->rttvar <<= 1;
+        }
     }
 
-    AddScratchLine( &scratch, HTTP_GET_METH );
-    AddScratchLine( &scratch, url->path );
-    AddScratchLine( &scratch, HTTP_VERSION );
-    AddScratchLine( &scratch, HTTP_LINE_ENDING );
-    AddScratchLine( &scratch, HTTP_HOST_HDR );
-    AddScratchLine( &scratch, url->host );
-    AddScratchLine( &scratch, HTTP_LINE_ENDING );
-    AddScratchLine( &scratch, HTTP_USERAGENT_LINE );
-    AddScratchLine( &scratch, HTTP_LINE_ENDING );
-   
-    if ( scratch.errFlag ) {
-        close( sock );
-        err = NetLibClose( AppNetRefnum, false );
-        return HTTPErr_TempDBErr;
-    }
+    QualitySave( quality );
+}
 
-    scratch.handle = DmQueryRecord( gHttpLib, scratch.index );
-    headers = MemHandleLock( scratch.handle );
-    SendAll( sock, headers, scratch.size );
-    MemHandleUnlock( scratch.handle );
 
-    MemSet( &parse, sizeof( parse ), 0 );
-    parse.state = PS_ResponseLine;
-    parse.saveFileName = resultsDB;
+/*
+ * Name:   QualityTrim()
+ * Args:   keep - most records to leave
+ * Return: none
+ * Desc:   Removes the least recently used host records until there are no
+ *         more than 'keep'.
+ */
 
-    ParseEngine( sock, &parse );
+static void QualityTrim( UInt16 keep )
+{
+    UInt16 recs;
+    UInt16 oldest;
+    UInt16 i;
+    UInt32 oldestUsed;
+    MemHandle handle;
+    HostQuality *rec;
 
-    close( sock );
-    NetLibClose( AppNetRefnum, false );
+    recs = DmNumRecords( gHttpLib );
+    while ( recs > keep ) {
+        oldest = 0;
+        oldestUsed = 0xFFFFFFFF;
+        for ( i = 0; i < recs; i++ ) {
+            handle = DmQueryRecord( gHttpLib, i );
+            if ( handle == NULL ) {
+                oldest = i;
+                break;
+            }
+            rec = (HostQuality *)MemHandleLock( handle );
+            if ( rec->lastUsed < oldestUsed ) {
+                oldest = i;
+                oldestUsed = rec->lastUsed;
+            }
+            MemHandleUnlock( handle );
+        }
 
-    if ( parse.state != PS_Done ) {
-        return HTTPErr_SizeMismatch;
+        DmRemoveRecord( gHttpLib, oldest );
+        recs--;
     }
-
-    return HTTPErr_OK;
 }
 
 
 /*
- * Name:   StartScratchArea()
- * Args:   scratch - struct to use for tracking the status of the area
+ * Name:   SockOpen()
+ * Args:   ctx - pointer to the socket ref to fill in
+ *         url - host and port to connect to
+ *         timeout - ticks to allow for the connect
  * Return: 0 on success, -1 on error
- * Desc:   Creates a new record, or resizes to minimal size, the record with 
- *         index 0 from the temp database.  Initializes the other fields in 
- *         the 'scratch' struct so that the area starts out blank.
+ * Desc:   Brings up the network library and connects a TCP socket to the
+ *         host.  The Berkeley style socket calls pick their timeout up from
+ *         AppNetTimeout, so the socket functions set it before each call.
  */
 
-static int StartScratchArea( ScratchRec *scratch )
+static Int16 SockOpen( void *ctx, URLTarget *url, Int32 timeout )
 {
-    scratch->index = 0;
+    NetSocketRef *sock;
+    Err err;
+    Err err2;
+    UInt8 allup;
 
-    if ( DmNumRecords( gHttpLib ) > 0 ) {
-        scratch->handle = DmResizeRecord( gHttpLib, scratch->index, 1 );
-        if ( scratch->handle == NULL ) {
-            scratch->errFlag = 1;
-            return -1;
-        }
-    } else {
-        scratch->handle = DmNewRecord( gHttpLib, &(scratch->index), 1 );
-        if ( scratch->handle == NULL ) {
-            scratch->errFlag = 1;
-            return -1;
-        }
-        DmReleaseRecord( gHttpLib, scratch->index, false );
+    sock = (NetSocketRef *)ctx;
+    AppNetRefnum = 0;
+
+    err = SysLibFind( "Net.lib", &AppNetRefnum );
+    err = NetLibOpen( AppNetRefnum, &err2 );
+    if ( (err && (err != netErrAlreadyOpen)) || err2 ) {
+        NetLibClose( AppNetRefnum, true );
+        return -1;
     }
 
-    scratch->size = 0;
-    scratch->errFlag = 0;
+    AppNetTimeout = timeout;
+
+    NetLibConnectionRefresh( AppNetRefnum, true, &allup, &err2 );
+
+    *sock = NetUTCPOpen( url->host, NULL, url->port );
+    if ( *sock < 0 ) {
+        NetLibClose( AppNetRefnum, true );
+        return -1;
+    }
 
     return 0;
 }
 
 
 /*
- * Name:   AddToScratch()
- * Args:   scratch - scratch area to add to
- *         text - pointer to the data to add
- *         length - number of bytes to add from the start of 'text'
- * Return: none
- * Desc:   Adds 'length' bytes to the end of the scratch record.  No status 
- *         is returned directly, on error a flag is set in the 'scratch' struct
- *         instead.  There's a cover, AddScratchLine(), which can be used to 
- *         add a null terminated character string without having to clutter up
- *         the calls with lots of StrLen() calls for the final arg.
+ * Name:   SockSend()
+ * Args:   ctx - pointer to the connected socket ref
+ *         data - bytes to write
+ *         length - number of bytes to write
+ *         timeout - ticks to allow for the write
+ * Return: number of bytes written, < 0 on error
+ * Desc:   Cover for send().
  */
 
-static void AddToScratch( ScratchRec *scratch, char *text, int length )
+static Int16 SockSend( void *ctx, char *data, UInt16 length, Int32 timeout )
 {
-    char *scratchTxt;
-    int newSize;
-
-    if ( scratch->errFlag ) {
-        return;
-    }
+    AppNetTimeout = timeout;
+    return send( *(NetSocketRef *)ctx, data, length, 0 );
+}
 
-    newSize = scratch->size + length;
 
-    scratch->handle = DmResizeRecord( gHttpLib, scratch->index, newSize );
-    if ( scratch->handle == NULL ) {
-        scratch->errFlag = 1;
-        return;
-    }
-    scratch->handle = DmGetRecord( gHttpLib, scratch->index );
+/*
+ * Name:   SockRecv()
+ * Args:   ctx - pointer to the connected socket ref
+ *         buffer - where to put the data read
+ *         length - space available in 'buffer'
+ *         timeout - ticks to allow for the read
+ * Return: number of bytes read, 0 at end of stream, < 0 on error
+ * Desc:   Cover for recv().
+ */
 
-    scratchTxt = MemHandleLock( scratch->handle );
-    if ( scratchTxt == NULL ) {
-        scratch->errFlag = 1;
-        DmReleaseRecord( gHttpLib, scratch->index, false );
-        return;
-    }
+static Int16 SockRecv( void *ctx, char *buffer, UInt16 length,
+                       Int32 timeout )
+{
+    AppNetTimeout = timeout;
+    return recv( *(NetSocketRef *)ctx, buffer, length, 0 );
+}
 
-    if ( DmWrite( scratchTxt, scratch->size, text, length ) != errNone ) {
-        scratch->errFlag = 1;
-        MemHandleUnlock( scratch->handle );
-        DmReleaseRecord( gHttpLib, scratch->index, false );
-        return;
-    }
 
-    MemHandleUnlock( scratch->handle );
-    DmReleaseRecord( gHttpLib, scratch->index, true );
+/*
+ * Name:   SockClose()
+ * Args:   ctx - pointer to the connected socket ref
+ * Return: none
+ * Desc:   Closes the socket and releases our hold on the network library.
+ */
 
-    scratch->size += length;
+static void SockClose( void *ctx )
+{
+    close( *(NetSocketRef *)ctx );
+    NetLibClose( AppNetRefnum, false );
 }
 
 
 /*
- * Name:   SendAll()
- * Args:   sock - socket to send over
- *         data - the bytes to send
- *         length - the number of bytes to send
- * Return: 0 on success, -1 on error
- * Desc:   Sends exactly 'length' bytes to the socket 'sock'.  If unable to 
- *         send the full set of data, it is considered an error.
+ * Name:   SockTicks()
+ * Args:   ctx - unused
+ * Return: current system tick count
+ * Desc:   The socket transport runs on the real clock.
  */
 
-int SendAll( NetSocketRef sock, char *data, UInt32 length )
+static UInt32 SockTicks( void *ctx )
 {
-    UInt32 written;
-    Int16 thisWrite;
+    return TimGetTicks();
+}
 
-    written = 0;
 
-    while ( written < length ) {
-        thisWrite = send( sock, &(data[written]), length - written, 0 );
-        if ( thisWrite <= 0 ) {
-            return -1;
-        }
-        written += thisWrite;
-    }
+/*
+ * Name:   SockNoDelay()
+ * Args:   ctx - pointer to the connected socket ref
+ *         on - true to turn off the Nagle algorithm
+ * Return: none
+ * Desc:   Sets TCP_NODELAY on the socket.  NetLib has nothing like 
+ *         TCP_CORK, the send window does that job for us.
+ */
 
-    return 0;
+static void SockNoDelay( void *ctx, Boolean on )
+{
+    Int32 flag;
+
+    flag = on ? 1 : 0;
+    NetLibSocketOptionSet( AppNetRefnum, *(NetSocketRef *)ctx,
+                           netSocketOptLevelTCP, netSocketOptTCPNoDelay,
+                           &flag, sizeof(flag), AppNetTimeout, &errno );
 }
 
 
@@ -630,31 +1570,40 @@ static char *NextBufByte( HTTPParse *parse )
 
 /*
  * Name:   FillReadBuff()
- * Args:   sock - socket to read from
- *         parse - the structure to write the data into
+ * Args:   parse - the structure to write the data into
  * Return: number of bytes read on success, -1 on error
- * Desc:   Attempts to read data from the socket 'sock' and write into the
- *         read buffer associated with 'parse'.  This function should only be
- *         called if data is needed (the parse can't succeed without having 
- *         more data).  If any data at all is read, the needData flag from 
- *         'parse' is cleared.  It's up to the parse functions to determine if
- *         the new data is enough to proceed, and if not to reset the flag and
- *         call this function again.
+ * Desc:   Attempts to read data from the transport for 'parse' and write
+ *         into the read buffer associated with 'parse'.  This function
+ *         should only be called if data is needed (the parse can't succeed
+ *         without having more data).  If any data at all is read, the
+ *         needData flag from 'parse' is cleared.  It's up to the parse
+ *         functions to determine if the new data is enough to proceed, and
+ *         if not to reset the flag and call this function again.
  */
 
-static int FillReadBuff( NetSocketRef sock, HTTPParse *parse )
+static int FillReadBuff( HTTPParse *parse )
 {
+    HTTPTransport *transport;
     int readRes;
 
     if ( BufSizeRemaining( parse ) == 0 ) {
         return -1;
     }
 
-    readRes = recv( sock, NextBufByte( parse ), BufSizeRemaining( parse ), 0 );
+    transport = parse->transport;
+    readRes = transport->recvData( transport->ctx, NextBufByte( parse ),
+                                   BufSizeRemaining( parse ),
+                                   parse->timeout );
     if ( readRes < 0 ) {
         return -1;
     }
 
+    if ( (readRes > 0) && (gStats.bytesReceived == 0) ) {
+        gStats.firstByteTicks = transport->ticks( transport->ctx ) - 
+                                gStatsStart;
+    }
+    gStats.bytesReceived += readRes;
+
     if ( readRes == 0 ) {
         parse->endOfStream = 1;
         parse->needData = 0;
@@ -680,17 +1629,10 @@ static int FillReadBuff( NetSocketRef sock, HTTPParse *parse )
 
 static int MarkEOL( HTTPParse *parse )
 {
-    int i;
     char *endOfLine;
 
-    i = 0;
-    endOfLine = NULL;
-    while ( (i < parse->bufferPos) && (endOfLine == NULL) ) {
-        if ( parse->readBuffer[i] == '\r' ) {
-            endOfLine = parse->readBuffer + i;
-        }
-        i++;
-    }
+    endOfLine = (char *)HTTPSpanChr( parse->readBuffer, NextBufByte( parse ),
+                                     '\r' );
 
     if ( (endOfLine == NULL) || (endOfLine == (NextBufByte( parse ) - 1)) ) {
         if ( parse->endOfStream ) {
@@ -749,8 +1691,7 @@ static char *ParseResponseCode( char *start )
 
 /*
  * Name:   ParseEngine()
- * Args:   sock - socket to read from
- *         parse - struct to use to store the parse state
+ * Args:   parse - struct to use to store the parse state
  * Return: none
  * Desc:   I've tried to structure this as a relatively generic parse loop,
  *         hoping that it'll somewhat match what's needed for an event driven
@@ -759,11 +1700,11 @@ static char *ParseResponseCode( char *start )
  *         been deposited in the read buffer.
  */
 
-static void ParseEngine( NetSocketRef sock, HTTPParse *parse )
+static void ParseEngine( HTTPParse *parse )
 {
     while ( (parse->state != PS_Error) && (parse->state != PS_Done) ) {
         if ( parse->needData == 1 ) {
-            if ( FillReadBuff( sock, parse ) < 0 ) {
+            if ( FillReadBuff( parse ) < 0 ) {
                 parse->state = PS_Error;
                 break;
             }
@@ -862,9 +1803,7 @@ static void ParseHeaders( HTTPParse *parse )
     if ( StrLen( parse->readBuffer ) == 0 ) {
         BufConsumeToPointer( parse, newFirstByte );
 
-        parse->fd = FileOpen( 0, parse->saveFileName, 'DATA', 'BRWS',
-                              fileModeReadWrite, NULL );
-        if ( parse->fd == NULL ) {
+        if ( BodyOpen( parse ) != 0 ) {
             parse->state = PS_Error;
             return;
         }
@@ -873,8 +1812,8 @@ static void ParseHeaders( HTTPParse *parse )
         return;
     }
 
-    if ( StrNCompare( parse->readBuffer, HTTP_CONTENTLENGTH_HDR, 
-                      StrLen( HTTP_CONTENTLENGTH_HDR ) ) == 0 ) {
+    if ( StrNCaselessCompare( parse->readBuffer, HTTP_CONTENTLENGTH_HDR, 
+                              StrLen( HTTP_CONTENTLENGTH_HDR ) ) == 0 ) {
         value = parse->readBuffer + StrLen( HTTP_CONTENTLENGTH_HDR );
         tmpLen = StrAToI( value );
         if ( tmpLen <= 0 ) {
@@ -896,23 +1835,31 @@ static void ParseHeaders( HTTPParse *parse )
  *         If we know the content length from one of the headers in the
  *         response we have a very exact target to hit.  If there was no length
  *         header we read till we hit end of file on the stream.  The data is
- *         written into a stream database as we grab it.
+ *         written into a stream database as we grab it, or handed to the
+ *         watch function if there is one.  If the watch function says it
+ *         has seen enough we're done, whatever's left is never read.
  */
 
 static void ParseBody( HTTPParse *parse )
 {
-    int bytesNeeded;
+    unsigned long bytesNeeded;
     int byteCount;
+    Boolean watchDone;
 
     if ( parse->contentLength != 0 ) {
         bytesNeeded = parse->contentLength - parse->contentRead;
         if ( bytesNeeded == 0 ) {
             parse->state = PS_Done;
-            FileClose( parse->fd );
+            BodyClose( parse );
             return;
         }
 
         if ( parse->bufferPos == 0 ) {
+            /* Closed before sending everything it said it would */
+            if ( parse->endOfStream != 0 ) {
+                parse->state = PS_Error;
+                return;
+            }
             parse->needData = 1;
             return;
         }
@@ -926,7 +1873,7 @@ static void ParseBody( HTTPParse *parse )
         if ( parse->bufferPos == 0 ) {
             if ( parse->endOfStream != 0 ) {
                 parse->state = PS_Done;
-                FileClose( parse->fd );
+                BodyClose( parse );
                 return;
             }
             parse->needData = 1;
@@ -936,9 +1883,184 @@ static void ParseBody( HTTPParse *parse )
         byteCount = parse->bufferPos;
     }
 
-    FileWrite( parse->fd, parse->readBuffer, 1, byteCount, NULL );
+    if ( (parse->fd != NULL) &&
+            (BodyWrite( parse, parse->readBuffer, byteCount ) != 0) ) {
+        parse->state = PS_Error;
+        return;
+    }
     parse->contentRead += byteCount;
+
+    watchDone = false;
+    if ( parse->watch != NULL ) {
+        watchDone = parse->watch( parse->watchCtx, parse->readBuffer,
+                                  byteCount );
+    }
+
     BufConsumeToPointer( parse, &(parse->readBuffer[byteCount]) );
+
+    if ( watchDone ) {
+        parse->state = PS_Done;
+        BodyClose( parse );
+    }
+}
+
+
+/*
+ * Name:   BodyOpen()
+ * Args:   parse - struct to use to track the parse
+ * Return: 0 on success, -1 on error
+ * Desc:   Opens the stream database the body gets saved into and sets up the
+ *         staging block.  If there isn't enough dynamic heap for the block
+ *         we carry on without it, writing each read straight through.  With
+ *         a watch function there's nothing to open.
+ */
+
+static int BodyOpen( HTTPParse *parse )
+{
+    parse->writeFill = 0;
+    parse->writeBlockSize = 0;
+    parse->writeBlock = NULL;
+
+    if ( parse->watch != NULL ) {
+        parse->fd = NULL;
+        return 0;
+    }
+
+    parse->fd = FileOpen( 0, parse->saveFileName, 'DATA', 'BRWS',
+                          fileModeReadWrite, NULL );
+    if ( parse->fd == NULL ) {
+        return -1;
+    }
+
+    if ( gWriteBlockSize > 0 ) {
+        parse->writeBlock = (char *)MemPtrNew( gWriteBlockSize );
+        if ( parse->writeBlock != NULL ) {
+            parse->writeBlockSize = gWriteBlockSize;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   BodyWrite()
+ * Args:   parse - struct to use to track the parse
+ *         data - body bytes to save
+ *         length - number of bytes in 'data'
+ * Return: 0 on success, -1 on error
+ * Desc:   Copies body data into the staging block, saving the block to the
+ *         results file each time it fills up.  If the block is empty and
+ *         there's at least a whole block of data it skips the copy and 
+ *         writes straight from 'data'.
+ */
+
+static int BodyWrite( HTTPParse *parse, char *data, UInt16 length )
+{
+    UInt16 count;
+
+    if ( parse->writeBlock == NULL ) {
+        return StorageWrite( parse, data, length );
+    }
+
+    while ( length > 0 ) {
+        if ( (parse->writeFill == 0) && (length >= parse->writeBlockSize) ) {
+            return StorageWrite( parse, data, length );
+        }
+
+        count = parse->writeBlockSize - parse->writeFill;
+        if ( count > length ) {
+            count = length;
+        }
+
+        MemMove( parse->writeBlock + parse->writeFill, data, count );
+        parse->writeFill += count;
+        data += count;
+        length -= count;
+
+        if ( parse->writeFill == parse->writeBlockSize ) {
+            if ( BodyFlush( parse ) != 0 ) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   BodyFlush()
+ * Args:   parse - struct to use to track the parse
+ * Return: 0 on success, -1 on error
+ * Desc:   Saves whatever is sitting in the staging block to the results
+ *         file and empties the block.
+ */
+
+static int BodyFlush( HTTPParse *parse )
+{
+    UInt16 fill;
+
+    if ( parse->writeFill == 0 ) {
+        return 0;
+    }
+
+    fill = parse->writeFill;
+    parse->writeFill = 0;
+
+    return StorageWrite( parse, parse->writeBlock, fill );
+}
+
+
+/*
+ * Name:   BodyClose()
+ * Args:   parse - struct to use to track the parse
+ * Return: none
+ * Desc:   Flushes the staging block, closes the results file and frees the
+ *         block.  Safe to call more than once, and on a parse that never 
+ *         got as far as the body, so the request functions call it on the 
+ *         way out to clean up after errors.  If the final flush fails the
+ *         parse is marked as an error.
+ */
+
+static void BodyClose( HTTPParse *parse )
+{
+    if ( parse->fd != NULL ) {
+        if ( (parse->writeBlock != NULL) && (BodyFlush( parse ) != 0) ) {
+            parse->state = PS_Error;
+        }
+        FileClose( parse->fd );
+        parse->fd = NULL;
+    }
+
+    if ( parse->writeBlock != NULL ) {
+        MemPtrFree( parse->writeBlock );
+        parse->writeBlock = NULL;
+    }
+}
+
+
+/*
+ * Name:   StorageWrite()
+ * Args:   parse - struct to use to track the parse
+ *         data - bytes to save
+ *         length - number of bytes in 'data'
+ * Return: 0 on success, -1 on error
+ * Desc:   The one place the body actually gets written to the results file.
+ */
+
+static int StorageWrite( HTTPParse *parse, char *data, UInt16 length )
+{
+    Err err;
+
+    gStats.storageWrites++;
+
+    FileWrite( parse->fd, data, 1, length, &err );
+    if ( err != errNone ) {
+        return -1;
+    }
+
+    return 0;
 }
 
 
@@ -47,13 +47,119 @@ typedef enum HTTPErr_enum {
     HTTPErr_ConnectError = 1,
     HTTPErr_TempDBErr = 2,
     HTTPErr_SizeMismatch = 3,
+    HTTPErr_NoMemory = 4,
 } HTTPErr;
 
 
+/*
+ * The transport is the set of network operations a request is driven
+ * through.  By default the library uses NetLib sockets, but a replacement
+ * can be installed with HTTPLibSetTransport() (netsim.c provides a
+ * simulated network for reproducing slow links).  All timeouts and clock
+ * values are in system ticks.  recvData() follows the Berkeley convention
+ * of returning the number of bytes read, 0 at end of stream and < 0 on
+ * error.  nodelay() may be NULL if the transport has no control over
+ * segmenting.  The members aren't called send, recv and close because
+ * the SDK's sys_socket.h defines those as macros.
+ */
+
+typedef struct HTTPTransport_struct {
+    Int16 (*openConn)( void *ctx, URLTarget *url, Int32 timeout );
+    Int16 (*sendData)( void *ctx, char *data, UInt16 length, Int32 timeout );
+    Int16 (*recvData)( void *ctx, char *buffer, UInt16 length,
+                       Int32 timeout );
+    void (*closeConn)( void *ctx );
+    UInt32 (*ticks)( void *ctx );
+    void (*nodelay)( void *ctx, Boolean on );
+    void *ctx;
+} HTTPTransport;
+
+
+/*
+ * Counters for the most recent request.  firstByteTicks is measured from the
+ * start of the request to the first byte of the response, totalTicks runs to
+ * the end of the response.  storageWrites is the number of FileWrite() calls
+ * made to save the response body.
+ */
+
+typedef struct HTTPStats_struct {
+    UInt32 bytesSent;
+    UInt32 bytesReceived;
+    UInt32 firstByteTicks;
+    UInt32 totalTicks;
+    UInt32 storageWrites;
+} HTTPStats;
+
+
+/*
+ * A watch function is handed each piece of the response body as it arrives,
+ * in place of saving it to the results DB.  Returning true tells the
+ * library the caller has everything it needs: the rest of the response is
+ * skipped, the connection is closed and the request counts as complete.
+ */
+
+typedef Boolean (*HTTPWatchFunc)( void *ctx, char *data, UInt16 length );
+
+
+/*
+ * A request body that's produced while it's being sent instead of built up
+ * in memory first.  'length' has to be known up front for the Content-Length
+ * header, and write() must then push exactly that many bytes into the send
+ * window with HTTPWindowWrite().  Network errors are tracked by the window,
+ * so write() doesn't need to check anything as it goes.
+ */
+
+typedef struct HTTPWindow_struct HTTPWindow;
+
+typedef void (*HTTPBodyFunc)( void *ctx, HTTPWindow *window );
+
+typedef struct HTTPBody_struct {
+    UInt32 length;
+    HTTPBodyFunc write;
+    void *ctx;
+} HTTPBody;
+
+
+/*
+ * Searching a span of bytes, from 'start' up to 'end', with no terminator
+ * needed.  HTTPSpanChr() looks for a single byte, a word at a time.  For
+ * longer needles an HTTPSearch is set up once with HTTPSearchInit(),
+ * usually for a constant, and then reused for any number of spans.  It
+ * uses Horspool's algorithm, which skips ahead by up to the length of the
+ * needle on a mismatch.  Both return NULL if there's no match.  A stream
+ * that arrives in pieces can be searched a piece at a time:
+ * HTTPSearchTail() says how much of the end of a span could be the start
+ * of the needle.
+ */
+
+#define HTTP_SEARCH_MAX (255)
+
+typedef struct HTTPSearch_struct {
+    const char *needle;
+    UInt8 length;
+    UInt8 shift[256];
+} HTTPSearch;
+
+
 int HTTPLibStart( UInt32 creator, int secTimeout );
 void HTTPLibStop( void );
+void HTTPLibSetTransport( HTTPTransport *transport );
+void HTTPLibSetWriteBlock( UInt16 size );
+void HTTPLibSetNoDelay( Boolean on );
+void HTTPLibGetStats( HTTPStats *stats );
 HTTPErr HTTPPost( URLTarget *url, char *data, char *resultsDB );
+HTTPErr HTTPPostWatch( URLTarget *url, char *data, char *resultsDB,
+                       HTTPWatchFunc watch, void *watchCtx );
+HTTPErr HTTPPostBody( URLTarget *url, HTTPBody *body, char *resultsDB,
+                      HTTPWatchFunc watch, void *watchCtx );
+void HTTPWindowWrite( HTTPWindow *window, const char *data, UInt32 length );
 HTTPErr HTTPGet( URLTarget *url, char *resultsDB );
+const char *HTTPSpanChr( const char *start, const char *end, char ch );
+void HTTPSearchInit( HTTPSearch *search, const char *needle );
+const char *HTTPSearchSpan( const HTTPSearch *search, const char *start,
+                            const char *end );
+UInt16 HTTPSearchTail( const HTTPSearch *search, const char *start,
+                       const char *end );
 
 
 #endif /* PALMHTTP_H_ */
@@ -0,0 +1,695 @@
+/* tag: simulated network transport for PalmHTTP
+ * arch-tag: simulated network transport for PalmHTTP
+ *
+ * PalmHTTP - an HTTP library for Palm devices
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+/*
+ * A transport for the HTTP library that never touches the network.  Each
+ * connection replays the next canned response from a queue, and the link is
+ * modelled with a round trip time, a bandwidth, a maximum segment size, a
+ * send window, jitter and an optional reset point.  Time is kept on a
+ * virtual clock that only moves when the simulated link would have been
+ * busy, so a run takes no real time and the same config always produces
+ * the same timings.  The HTTP library reads the clock through the
+ * transport, so HTTPLibGetStats() reports the simulated latency and byte
+ * counts.
+ *
+ * Only compiled in when HTTP_NETSIM is defined (see the Makefile).
+ */
+
+#include <PalmOS.h>
+
+#include "http.h"
+#include "netsim.h"
+
+#if defined(HTTP_NETSIM)
+
+#define NETSIM_MAX_RESPONSES (4)
+#define NETSIM_MAX_FLIGHT (16)
+
+
+/*
+ * State for the single simulated connection.  'now' is the virtual clock
+ * in milliseconds.  'awaitingReply' is set once the client has sent
+ * something and cleared when the first byte of the reply arrives, that's
+ * where the round trip gets charged.  The request segments that haven't
+ * been acked yet are kept in a ring, oldest first, with the time each ack
+ * gets back.
+ */
+
+typedef struct NetSim_struct {
+    NetSimConfig config;
+    UInt32 now;
+    UInt32 random;
+    const char *responses[NETSIM_MAX_RESPONSES];
+    UInt32 lengths[NETSIM_MAX_RESPONSES];
+    UInt16 queued;
+    UInt16 nextResponse;
+    const char *current;
+    UInt32 currentLength;
+    UInt32 delivered;
+    Boolean connected;
+    Boolean awaitingReply;
+    UInt32 ackAt[NETSIM_MAX_FLIGHT];
+    UInt16 ackLength[NETSIM_MAX_FLIGHT];
+    UInt16 flightStart;
+    UInt16 flightCount;
+    UInt32 inFlight;
+    NetSimStats stats;
+} NetSim;
+
+
+/*
+ * Local prototypes (private to this file)
+ */
+
+static Int16 SimOpen( void *ctx, URLTarget *url, Int32 timeout );
+static Int16 SimSend( void *ctx, char *data, UInt16 length, Int32 timeout );
+static Int16 SimRecv( void *ctx, char *buffer, UInt16 length, Int32 timeout );
+static void SimClose( void *ctx );
+static UInt32 SimTicks( void *ctx );
+
+static UInt32 WireTime( NetSim *sim, UInt32 bytes );
+static void TakeAcks( NetSim *sim );
+static UInt32 NextJitter( NetSim *sim );
+static UInt32 TicksToMs( Int32 ticks );
+static UInt32 BodyOffset( const char *response, UInt32 length );
+
+
+/*
+ * Private globals
+ */
+
+static NetSim gSim;
+static HTTPTransport gSimTransport = {
+    SimOpen, SimSend, SimRecv, SimClose, SimTicks, NULL, &gSim
+};
+
+
+/*
+ * Link setups for the canned scenarios.  The GPRS numbers are roughly what
+ * a Treo 600 sees on a decent day: most of a second of round trip, a few
+ * kilobytes a second, and small segments with some variance.  The window
+ * is four segments, so a long entry goes out in bursts between acks.
+ */
+
+static const NetSimConfig gGPRSLink = {
+    800,        /* rttMs */
+    4000,       /* bytesPerSec */
+    536,        /* segmentSize */
+    2144,       /* windowSize */
+    300,        /* jitterMs */
+    0,          /* resetAfter */
+    0x5EED      /* seed */
+};
+
+static const char gUsersBlogsResponse[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: text/xml\r\n"
+    "\r\n"
+    "<?xml version=\"1.0\"?>\n"
+    "<methodResponse>\n"
+    "  <params>\n"
+    "    <param>\n"
+    "      <value><array><data>\n"
+    "        <value><struct>\n"
+    "          <member><name>url</name>"
+    "<value><string>http://example.com/one/</string></value></member>\n"
+    "          <member><name>blogid</name>"
+    "<value><string>1001</string></value></member>\n"
+    "          <member><name>blogName</name>"
+    "<value><string>First Blog</string></value></member>\n"
+    "        </struct></value>\n"
+    "        <value><struct>\n"
+    "          <member><name>url</name>"
+    "<value><string>http://example.com/two/</string></value></member>\n"
+    "          <member><name>blogid</name>"
+    "<value><string>1002</string></value></member>\n"
+    "          <member><name>blogName</name>"
+    "<value><string>Second Blog</string></value></member>\n"
+    "        </struct></value>\n"
+    "      </data></array></value>\n"
+    "    </param>\n"
+    "  </params>\n"
+    "</methodResponse>\n";
+
+static const char gNewPostResponse[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: text/xml\r\n"
+    "Content-Length: 154\r\n"
+    "\r\n"
+    "<?xml version=\"1.0\"?>\n"
+    "<methodResponse>\n"
+    "  <params>\n"
+    "    <param>\n"
+    "      <value><string>4815162342</string></value>\n"
+    "    </param>\n"
+    "  </params>\n"
+    "</methodResponse>\n";
+
+static const char gListMethodsResponse[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: text/xml\r\n"
+    "\r\n"
+    "<?xml version=\"1.0\"?>\n"
+    "<methodResponse>\n"
+    "  <params>\n"
+    "    <param>\n"
+    "      <value><array><data>\n"
+    "        <value><string>blogger.getUsersBlogs</string></value>\n"
+    "        <value><string>blogger.newPost</string></value>\n"
+    "        <value><string>metaWeblog.newPost</string></value>\n"
+    "        <value><string>system.listMethods</string></value>\n"
+    "        <value><string>system.multicall</string></value>\n"
+    "      </data></array></value>\n"
+    "    </param>\n"
+    "  </params>\n"
+    "</methodResponse>\n";
+
+static const char gNoListMethodsResponse[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: text/xml\r\n"
+    "\r\n"
+    "<?xml version=\"1.0\"?>\n"
+    "<methodResponse>\n"
+    "  <fault><value><struct>\n"
+    "    <member><name>faultCode</name><value><int>0</int></value>"
+    "</member>\n"
+    "    <member><name>faultString</name><value><string>No such method "
+    "system.listMethods</string></value></member>\n"
+    "  </struct></value></fault>\n"
+    "</methodResponse>\n";
+
+static const char gMulticallResponse[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: text/xml\r\n"
+    "\r\n"
+    "<?xml version=\"1.0\"?>\n"
+    "<methodResponse>\n"
+    "  <params>\n"
+    "    <param>\n"
+    "      <value><array><data>\n"
+    "        <value><array><data>\n"
+    "          <value><string>4815162342</string></value>\n"
+    "        </data></array></value>\n"
+    "        <value><array><data>\n"
+    "          <value><array><data>\n"
+    "            <value><struct>\n"
+    "              <member><name>blogid</name>"
+    "<value><string>1001</string></value></member>\n"
+    "              <member><name>blogName</name>"
+    "<value><string>First Blog</string></value></member>\n"
+    "            </struct></value>\n"
+    "            <value><struct>\n"
+    "              <member><name>blogid</name>"
+    "<value><string>1002</string></value></member>\n"
+    "              <member><name>blogName</name>"
+    "<value><string>Second Blog</string></value></member>\n"
+    "            </struct></value>\n"
+    "          </data></array></value>\n"
+    "        </data></array></value>\n"
+    "      </data></array></value>\n"
+    "    </param>\n"
+    "  </params>\n"
+    "</methodResponse>\n";
+
+
+/*
+ * Name:   NetSimStart()
+ * Args:   config - link characteristics to simulate
+ * Return: the transport to pass to HTTPLibSetTransport()
+ * Desc:   Resets the virtual clock and the response queue and sets up the
+ *         link.  Responses have to be queued with NetSimQueueResponse()
+ *         before any requests are made.
+ */
+
+HTTPTransport *NetSimStart( const NetSimConfig *config )
+{
+    MemSet( &gSim, sizeof(gSim), 0 );
+    MemMove( &(gSim.config), config, sizeof(NetSimConfig) );
+    gSim.random = config->seed;
+
+    if ( gSim.config.segmentSize == 0 ) {
+        gSim.config.segmentSize = 1;
+    }
+    if ( gSim.config.bytesPerSec == 0 ) {
+        gSim.config.bytesPerSec = 1;
+    }
+    if ( gSim.config.windowSize < gSim.config.segmentSize ) {
+        gSim.config.windowSize = gSim.config.segmentSize;
+    }
+
+    return &gSimTransport;
+}
+
+
+/*
+ * Name:   NetSimLoadScenario()
+ * Args:   scenario - which canned setup to load
+ * Return: the transport to pass to HTTPLibSetTransport()
+ * Desc:   Sets up the link and queues the server responses for one of the
+ *         standard scenarios:
+ *           NSS_RefreshThenPost - a blog list refresh followed by a post,
+ *                                 which finds the server takes
+ *                                 system.multicall and sends the post
+ *                                 and another refresh as one batch
+ *           NSS_LargePost - a post to a server without system.multicall,
+ *                           so the post and refresh go one after the
+ *                           other.  Run with a long entry, which takes
+ *                           several windows to send
+ *           NSS_DropAfterHeaders - the server resets the connection right
+ *                                  after sending the response headers
+ */
+
+HTTPTransport *NetSimLoadScenario( NetSimScenario scenario )
+{
+    NetSimConfig config;
+    HTTPTransport *transport;
+
+    MemMove( &config, &gGPRSLink, sizeof(NetSimConfig) );
+
+    switch ( scenario ) {
+        case NSS_RefreshThenPost:
+            transport = NetSimStart( &config );
+            NetSimQueueResponse( gUsersBlogsResponse,
+                                 sizeof(gUsersBlogsResponse) - 1 );
+            NetSimQueueResponse( gListMethodsResponse,
+                                 sizeof(gListMethodsResponse) - 1 );
+            NetSimQueueResponse( gMulticallResponse,
+                                 sizeof(gMulticallResponse) - 1 );
+            break;
+
+        case NSS_DropAfterHeaders:
+            config.resetAfter = BodyOffset( gNewPostResponse,
+                                            sizeof(gNewPostResponse) - 1 );
+            transport = NetSimStart( &config );
+            NetSimQueueResponse( gNewPostResponse,
+                                 sizeof(gNewPostResponse) - 1 );
+            break;
+
+        case NSS_LargePost:
+        default:
+            transport = NetSimStart( &config );
+            NetSimQueueResponse( gNoListMethodsResponse,
+                                 sizeof(gNoListMethodsResponse) - 1 );
+            NetSimQueueResponse( gNewPostResponse,
+                                 sizeof(gNewPostResponse) - 1 );
+            NetSimQueueResponse( gUsersBlogsResponse,
+                                 sizeof(gUsersBlogsResponse) - 1 );
+            break;
+    }
+
+    return transport;
+}
+
+
+/*
+ * Name:   NetSimQueueResponse()
+ * Args:   response - full response text, status line and headers included
+ *         length - number of bytes in 'response'
+ * Return: 0 on success, -1 if the queue is full
+ * Desc:   Each connection opened on the simulated transport replays the next
+ *         queued response.  The text isn't copied.
+ */
+
+int NetSimQueueResponse( const char *response, UInt32 length )
+{
+    if ( gSim.queued == NETSIM_MAX_RESPONSES ) {
+        return -1;
+    }
+
+    gSim.responses[gSim.queued] = response;
+    gSim.lengths[gSim.queued] = length;
+    gSim.queued++;
+
+    return 0;
+}
+
+
+/*
+ * Name:   NetSimNow()
+ * Args:   none
+ * Return: the virtual clock in milliseconds
+ * Desc:
+ */
+
+UInt32 NetSimNow( void )
+{
+    return gSim.now;
+}
+
+
+/*
+ * Name:   NetSimGetStats()
+ * Args:   stats - filled in with the counters since NetSimStart()
+ * Return: none
+ * Desc:
+ */
+
+void NetSimGetStats( NetSimStats *stats )
+{
+    MemMove( stats, &(gSim.stats), sizeof(NetSimStats) );
+}
+
+
+/*
+ * Name:   SimOpen()
+ * Args:   ctx - the simulator state
+ *         url - unused, every host connects
+ *         timeout - ticks to allow for the connect
+ * Return: 0 on success, -1 on error
+ * Desc:   Charges one round trip for the handshake and picks up the next
+ *         queued response.  Fails if the queue has run dry or the handshake
+ *         would take longer than the timeout.
+ */
+
+static Int16 SimOpen( void *ctx, URLTarget *url, Int32 timeout )
+{
+    NetSim *sim;
+    UInt32 delay;
+
+    sim = (NetSim *)ctx;
+
+    delay = sim->config.rttMs + NextJitter( sim );
+    if ( delay > TicksToMs( timeout ) ) {
+        sim->now += TicksToMs( timeout );
+        return -1;
+    }
+    sim->now += delay;
+
+    if ( sim->nextResponse >= sim->queued ) {
+        return -1;
+    }
+
+    sim->current = sim->responses[sim->nextResponse];
+    sim->currentLength = sim->lengths[sim->nextResponse];
+    sim->nextResponse++;
+    sim->delivered = 0;
+    sim->connected = true;
+    sim->awaitingReply = false;
+    sim->flightStart = 0;
+    sim->flightCount = 0;
+    sim->inFlight = 0;
+
+    return 0;
+}
+
+
+/*
+ * Name:   SimSend()
+ * Args:   ctx - the simulator state
+ *         data - unused, the request content doesn't matter
+ *         length - number of bytes being sent
+ *         timeout - ticks to allow for the write
+ * Return: number of bytes written, < 0 on error
+ * Desc:   Cuts the data into segments and puts each on the wire in turn.
+ *         When the window is full the send waits for the oldest segment's
+ *         ack.  If the timeout runs out part way through, whatever got
+ *         out is reported, the way a socket send would.
+ */
+
+static Int16 SimSend( void *ctx, char *data, UInt16 length, Int32 timeout )
+{
+    NetSim *sim;
+    UInt32 allowed;
+    UInt32 spent;
+    UInt32 delay;
+    UInt16 segment;
+    UInt16 sent;
+    UInt16 slot;
+
+    sim = (NetSim *)ctx;
+    if ( !sim->connected ) {
+        return -1;
+    }
+
+    allowed = TicksToMs( timeout );
+    spent = 0;
+    sent = 0;
+
+    while ( sent < length ) {
+        segment = length - sent;
+        if ( segment > sim->config.segmentSize ) {
+            segment = sim->config.segmentSize;
+        }
+
+        TakeAcks( sim );
+        if ( ((sim->inFlight + segment) > sim->config.windowSize) ||
+                (sim->flightCount == NETSIM_MAX_FLIGHT) ) {
+            /* Window's full, wait for the oldest ack */
+            delay = sim->ackAt[sim->flightStart] - sim->now;
+            if ( (spent + delay) > allowed ) {
+                sim->now += allowed - spent;
+                break;
+            }
+            sim->now += delay;
+            spent += delay;
+            sim->stats.windowStalls++;
+            sim->stats.stallMs += delay;
+            continue;
+        }
+
+        delay = WireTime( sim, segment );
+        if ( (spent + delay) > allowed ) {
+            sim->now += allowed - spent;
+            break;
+        }
+        sim->now += delay;
+        spent += delay;
+
+        slot = (sim->flightStart + sim->flightCount) % NETSIM_MAX_FLIGHT;
+        sim->ackAt[slot] = sim->now + sim->config.rttMs + NextJitter( sim );
+        sim->ackLength[slot] = segment;
+        sim->flightCount++;
+        sim->inFlight += segment;
+        sim->stats.segmentsSent++;
+        sent += segment;
+    }
+
+    if ( (sent == 0) && (length != 0) ) {
+        return -1;
+    }
+    sim->awaitingReply = true;
+
+    return sent;
+}
+
+
+/*
+ * Name:   SimRecv()
+ * Args:   ctx - the simulator state
+ *         buffer - where to put the data read
+ *         length - space available in 'buffer'
+ *         timeout - ticks to allow for the read
+ * Return: number of bytes read, 0 at end of stream, < 0 on error
+ * Desc:   Hands back at most one segment of the current response.  The
+ *         first read after a send also waits out the round trip.  Once the
+ *         reset point is reached every read fails.
+ */
+
+static Int16 SimRecv( void *ctx, char *buffer, UInt16 length, Int32 timeout )
+{
+    NetSim *sim;
+    UInt32 remaining;
+    UInt32 count;
+    UInt32 delay;
+
+    sim = (NetSim *)ctx;
+    if ( !sim->connected ) {
+        return -1;
+    }
+
+    if ( (sim->config.resetAfter != 0) &&
+            (sim->delivered >= sim->config.resetAfter) ) {
+        return -1;
+    }
+
+    remaining = sim->currentLength - sim->delivered;
+    if ( remaining == 0 ) {
+        return 0;
+    }
+
+    count = sim->config.segmentSize;
+    if ( count > length ) {
+        count = length;
+    }
+    if ( count > remaining ) {
+        count = remaining;
+    }
+    if ( (sim->config.resetAfter != 0) &&
+            ((sim->delivered + count) > sim->config.resetAfter) ) {
+        count = sim->config.resetAfter - sim->delivered;
+    }
+
+    delay = WireTime( sim, count ) + NextJitter( sim );
+    if ( sim->awaitingReply ) {
+        delay += sim->config.rttMs;
+        sim->awaitingReply = false;
+    }
+    if ( delay > TicksToMs( timeout ) ) {
+        sim->now += TicksToMs( timeout );
+        return -1;
+    }
+    sim->now += delay;
+
+    MemMove( buffer, sim->current + sim->delivered, count );
+    sim->delivered += count;
+
+    return count;
+}
+
+
+/*
+ * Name:   SimClose()
+ * Args:   ctx - the simulator state
+ * Return: none
+ * Desc:
+ */
+
+static void SimClose( void *ctx )
+{
+    ((NetSim *)ctx)->connected = false;
+}
+
+
+/*
+ * Name:   SimTicks()
+ * Args:   ctx - the simulator state
+ * Return: the virtual clock converted to system ticks
+ * Desc:   Split up to keep the multiply from overflowing on long runs.
+ */
+
+static UInt32 SimTicks( void *ctx )
+{
+    UInt32 now;
+    UInt32 tps;
+
+    now = ((NetSim *)ctx)->now;
+    tps = SysTicksPerSecond();
+
+    return ((now / 1000) * tps) + (((now % 1000) * tps) / 1000);
+}
+
+
+/*
+ * Name:   WireTime()
+ * Args:   sim - the simulator state
+ *         bytes - size of the transfer
+ * Return: milliseconds needed to move 'bytes' across the link
+ * Desc:
+ */
+
+static UInt32 WireTime( NetSim *sim, UInt32 bytes )
+{
+    return ((bytes / sim->config.bytesPerSec) * 1000) +
+           (((bytes % sim->config.bytesPerSec) * 1000) /
+            sim->config.bytesPerSec);
+}
+
+
+/*
+ * Name:   TakeAcks()
+ * Args:   sim - the simulator state
+ * Return: none
+ * Desc:   Drops the segments whose acks are back by now from the window.
+ */
+
+static void TakeAcks( NetSim *sim )
+{
+    while ( (sim->flightCount > 0) &&
+            (sim->ackAt[sim->flightStart] <= sim->now) ) {
+        sim->inFlight -= sim->ackLength[sim->flightStart];
+        sim->flightStart = (sim->flightStart + 1) % NETSIM_MAX_FLIGHT;
+        sim->flightCount--;
+    }
+}
+
+
+/*
+ * Name:   NextJitter()
+ * Args:   sim - the simulator state
+ * Return: a delay between 0 and the configured jitter, in milliseconds
+ * Desc:   Plain linear congruential generator, we only need the sequence to
+ *         be repeatable, not particularly random.
+ */
+
+static UInt32 NextJitter( NetSim *sim )
+{
+    if ( sim->config.jitterMs == 0 ) {
+        return 0;
+    }
+
+    sim->random = (sim->random * 1103515245UL) + 12345UL;
+    return (sim->random >> 16) % (sim->config.jitterMs + 1);
+}
+
+
+/*
+ * Name:   TicksToMs()
+ * Args:   ticks - a timeout as passed in by the HTTP library
+ * Return: the same span in milliseconds
+ * Desc:
+ */
+
+static UInt32 TicksToMs( Int32 ticks )
+{
+    UInt32 tps;
+
+    if ( ticks <= 0 ) {
+        return 0;
+    }
+
+    tps = SysTicksPerSecond();
+    return ((ticks / tps) * 1000) + (((ticks % tps) * 1000) / tps);
+}
+
+
+/*
+ * Name:   BodyOffset()
+ * Args:   response - full response text
+ *         length - number of bytes in 'response'
+ * Return: offset of the first body byte, or 'length' if there's no body
+ * Desc:   Used to place the reset point just after the headers.
+ */
+
+static UInt32 BodyOffset( const char *response, UInt32 length )
+{
+    UInt32 i;
+
+    for ( i = 0; (i + 3) < length; i++ ) {
+        if ( (response[i] == '\r') && (response[i + 1] == '\n') &&
+                (response[i + 2] == '\r') && (response[i + 3] == '\n') ) {
+            return i + 4;
+        }
+    }
+
+    return length;
+}
+
+#endif /* HTTP_NETSIM */
@@ -0,0 +1,94 @@
+/* tag: simulated network transport header file for PalmHTTP
+ * arch-tag: simulated network transport header file for PalmHTTP
+ *
+ * PalmHTTP - an HTTP library for Palm devices
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#if !defined(NETSIM_H_)
+#define NETSIM_H_ 1
+
+#include <PalmOS.h>
+
+#include "http.h"
+
+
+/*
+ * Link characteristics for the simulated network.  Times are in
+ * milliseconds of virtual time.  segmentSize caps the number of bytes a
+ * single recvData() hands back, which is how the small reads seen over
+ * GPRS are reproduced, and is also the size the request is cut into on
+ * the way out.  windowSize is how many bytes of the request can be out
+ * before an ack has to come back, each segment is acked a round trip after
+ * it's sent.  If resetAfter is non-zero the connection is reset once that
+ * many bytes of the response have been delivered.  The same seed always
+ * produces the same jitter sequence.
+ */
+
+typedef struct NetSimConfig_struct {
+    UInt32 rttMs;
+    UInt32 bytesPerSec;
+    UInt16 segmentSize;
+    UInt16 windowSize;
+    UInt32 jitterMs;
+    UInt32 resetAfter;
+    UInt32 seed;
+} NetSimConfig;
+
+
+/*
+ * Canned setups matching the cases we get reports about from the field.
+ */
+
+typedef enum NetSimScenario_enum {
+    NSS_RefreshThenPost = 0,
+    NSS_LargePost = 1,
+    NSS_DropAfterHeaders = 2
+} NetSimScenario;
+
+
+/*
+ * Counters for the request side of the link since NetSimStart().
+ * windowStalls is the number of times a send had to wait for an ack before
+ * the next segment could go, and stallMs is the total time spent waiting.
+ */
+
+typedef struct NetSimStats_struct {
+    UInt32 segmentsSent;
+    UInt32 windowStalls;
+    UInt32 stallMs;
+} NetSimStats;
+
+
+HTTPTransport *NetSimStart( const NetSimConfig *config );
+HTTPTransport *NetSimLoadScenario( NetSimScenario scenario );
+int NetSimQueueResponse( const char *response, UInt32 length );
+UInt32 NetSimNow( void );
+void NetSimGetStats( NetSimStats *stats );
+
+
+#endif /* NETSIM_H_ */
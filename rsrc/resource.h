@@ -56,11 +56,14 @@
 #define EndUnderlineMItem 1112
 #define EndItalicMItem 1113
 #define EndEmphasisMItem 1114
+#define DraftsMItem 1115
+#define NewDraftMItem 1116
 
 #define PostErrAlert 1200
 #define PostSuccessAlert 1201
 #define UnregPostSuccessAlert 1202
 #define PostExpiredEvalAlert 1203
+#define NetStatsAlert 1204
 
 #define PostActionForm 1300
 #define PostActionStatus 1301
@@ -132,4 +135,18 @@
 #define PostOptOKMItem 7007
 #define PostOptCancelMItem 7008
 
+#define DraftListForm 8000
+#define DraftList 8001
+#define DraftOpenBtn 8002
+#define DraftNewBtn 8003
+#define DraftDeleteBtn 8004
+#define DraftCancelBtn 8005
+#define DraftListHlp 8006
+#define DraftListMenu 8007
+#define DraftOpenMItem 8008
+#define DraftNewMItem 8009
+#define DraftDeleteMItem 8010
+#define DraftCancelMItem 8011
+#define DeleteDraftAlert 8012
+
 #endif /* RESOURCE_H_ */
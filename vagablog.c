@@ -39,6 +39,8 @@
 #include "rsrc/resource.h"
 
 #include "http.h"
+#include "netsim.h"
+#include "xmlrpc.h"
 
 
 #define VAGABLOG_ID "77783D0E1EE8808BD4D3327D1EB2601C78DB3D65"
@@ -46,19 +48,22 @@
 const unsigned long gCreator = 'VBlg';
 const unsigned long gDBType = 'Data';
 const char gDBName[] = "VagablogDB";
+const UInt16 gDBVersion = 1;
 const unsigned long gPrefDBType = 'Pref';
 const char gPrefDBName[] = "VagablogPrefDB";
 const unsigned long gAppPrefID = 0;
 const unsigned long gAppPrefVersion = 6;
+const unsigned long gDraftPrefID = 1;
+const unsigned long gDraftPrefVersion = 1;
 
 const char gDefaultHost[] = "www.blogger.com";
 const char gDefaultPort[] = "80";
 const char gDefaultURL[] = "/api/RPC2";
 const char gDefaultTimeout[] = "60";
 
+/* Shown in the draft list for a record that isn't a draft */
+const char gDamagedDraft[] = "(damaged)";
 
-/* Used to store the text returned by the XMLRPC server */
-const char gTempDBName[] = "VBLGTempDATA";
 
 
 #define FIELD_LEN (64)
@@ -71,11 +76,24 @@ const char gTempDBName[] = "VBLGTempDATA";
 #define BLOG_ID_LEN (12)
 #define REGCODE_LEN FIELD_LEN
 #define BLOG_NAME_LEN (50)
-#define INFOREQ_SIZE (17000)
 
 #define NUM_UNREGPOSTS (5)
 #define MAX_BLOGS (10)
 
+/*
+ * Settings for runs against the simulated network, these can be given on
+ * the command line along with NETSIM_SCENARIO to compare them.
+ */
+#if defined(HTTP_NETSIM)
+#if !defined(NETSIM_WRITE_BLOCK)
+#define NETSIM_WRITE_BLOCK (4096)
+#endif
+#if !defined(NETSIM_NODELAY)
+#define NETSIM_NODELAY (true)
+#endif
+#define NETSIM_REPORT_LEN (128)
+#endif
+
 
 /*
  * Represents the information about a single blog.  Saving the string unpadded
@@ -215,115 +233,92 @@ static DmOpenRef gPrefDBRef = NULL;
 
 
 /*
- * Used to pass info into and out of the create link popup
+ * Each record in the posts database is a draft: a DraftHeader, then the
+ * title, category and post text, each '\0' terminated.  'size' is the
+ * length of the text.  Records are kept newest first by 'modified', so the
+ * draft list is just the records in order.  A draft is known by its
+ * record's unique ID, which stays the same when the record moves.
+ * gDraftID is the draft being edited, 0 for a new post that hasn't been
+ * saved yet, and is kept between runs as a second app preference.
  */
 
-static char *gLinkText = NULL;
-static char *gLinkURL = NULL;
+#define DS_UNSENT (0)
+#define DS_POSTED (1)
 
+#define DRAFT_MAX_SIZE ((UInt32)0xFFFF)
 
-/*
- * Used to store info about a fault returned by the XMLRPC server.  We put the
- * XMLRPC server message up in the alert box to try to give the user a bit of
- * a clue.
- */
-
-#define FAULT_STR_LEN (256)
+typedef struct DraftHeader_struct {
+    UInt32 created;
+    UInt32 modified;
+    char blogID[BLOG_ID_LEN];
+    UInt16 state;
+    UInt16 size;
+} DraftHeader;
 
-typedef struct FaultInfo_struct {
-    Int32 code;
-    char string[FAULT_STR_LEN];
-} FaultInfo;
+static UInt32 gDraftID = 0;
+static UInt16 gDraftState = DS_UNSENT;
 
 
 /*
- * XMLRPC call templates
+ * Wire ready (escaped) copies of the user name and password, so requests
+ * can drop them straight in without allocating or scanning anything.  The
+ * credentials only change when prefs are loaded or the identity form is
+ * saved, and both of those call CredentialsChanged().  That bumps
+ * gCredVersion and rebuilds the cache.  EscapedCredentials() checks the
+ * version too, so a change that forgets to say so is still picked up.
  */
 
-static char *gUsersBlogsReq = \
-    "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n" \
-    "<methodCall>\n" \
-    "  <methodName>blogger.getUsersBlogs</methodName>\n" \
-    "  <params>\n" \
-    "    <param>\n" \
-    "      <value><string>" VAGABLOG_ID "</string></value>\n" \
-    "    </param>\n" \
-    "    <param>\n" \
-    "      <value><string>%s</string></value>\n" \
-    "    </param>\n" \
-    "    <param>\n" \
-    "      <value><string>%s</string></value>\n" \
-    "    </param>\n" \
-    "  </params>\n" \
-    "</methodCall>";
-
-static char *gNewPostReq = \
-    "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n" \
-    "<methodCall>\n" \
-    "  <methodName>blogger.newPost</methodName>\n" \
-    "  <params>\n" \
-    "    <param>\n" \
-    "      <value><string>" VAGABLOG_ID "</string></value>\n" \
-    "    </param>\n" \
-    "    <param>\n" \
-    "      <value><string>%s</string></value>\n" \
-    "    </param>\n" \
-    "    <param>\n" \
-    "      <value><string>%s</string></value>\n" \
-    "    </param>\n" \
-    "    <param>\n" \
-    "      <value><string>%s</string></value>\n" \
-    "    </param>\n" \
-    "    <param>\n" \
-    "      <value><string>%s%s%s</string></value>\n" \
-    "    </param>\n" \
-    "    <param>\n" \
-    "      <value><boolean>%d</boolean></value>\n" \
-    "    </param>\n" \
-    "  </params>\n" \
-    "</methodCall>\n";
-
+typedef struct CredCache_struct {
+    UInt16 version;
+    char name[XR_ESCAPED_SIZE( NAME_LEN - 1 )];
+    char pass[XR_ESCAPED_SIZE( PASS_LEN - 1 )];
+} CredCache;
 
-static const char *gXMLDeclStart = "<?xml";
-static const char *gXMLDeclEnd  = "?>";
+static CredCache gCredCache;
+static UInt16 gCredVersion = 1;
 
-static const char *gXMLRPCParamsStart = "<params>";
-static const char *gXMLRPCParamsEnd = "</params>";
 
-static const char *gXMLRPCParamStart = "<param>";
-static const char *gXMLRPCParamEnd = "</param>";
+/*
+ * Used to pass info into and out of the create link popup
+ */
 
-static const char *gXMLRPCFaultStart = "<fault>";
-static const char *gXMLRPCFaultEnd = "</fault>";
+static char *gLinkText = NULL;
+static char *gLinkURL = NULL;
 
-static const char *gXMLRPCStructStart = "<struct>";
-static const char *gXMLRPCStructEnd = "</struct>";
 
-static const char *gXMLRPCValueStart = "<value>";
-static const char *gXMLRPCValueEnd = "</value>";
+/*
+ * The method a post is made with and the function that writes its params,
+ * which depend on the blog type, see PostAPIForType().
+ */
 
-static const char *gXMLRPCNameStart = "<name>";
-static const char *gXMLRPCNameEnd = "</name>";
+typedef struct PostAPI_struct {
+    const char *method;
+    XRBuildFunc params;
+} PostAPI;
 
-static const char *gXMLRPCMemberStart = "<member>";
-static const char *gXMLRPCMemberEnd = "</member>";
 
-static const char *gXMLRPCIntStart = "<int>";
-static const char *gXMLRPCIntEnd = "</int>";
+/*
+ * What goes into a post request.
+ */
 
-static const char *gXMLRPCI4Start = "<i4>";
-static const char *gXMLRPCI4End = "</i4>";
+typedef struct PostContent_struct {
+    const PostAPI *api;
+    const char *title;
+    const char *category;
+    const char *body;
+    Boolean publish;
+} PostContent;
 
-static const char *gXMLRPCStringStart = "<string>";
-static const char *gXMLRPCStringEnd = "</string>";
 
-static const char *gXMLRPCFaultName = "faultString";
+/*
+ * Whether the server takes system.multicall, found out by XRBatchRun() the
+ * first time a post is made and forgotten when the server settings change.
+ * Buffer the batch's responses are kept in while they're picked through.
+ */
 
-static const char *gTitleBegin = "&lt;title&gt;";
-static const char *gTitleEnd = "&lt;/title&gt;";
+static UInt8 gMulticall = XR_MULTICALL_UNKNOWN;
 
-static const char *gCatBegin = "&lt;category&gt;";
-static const char *gCatEnd = "&lt;/category&gt;";
+#define BATCH_TREE_SIZE (8192)
 
 
 /*
@@ -355,20 +350,26 @@ static void SetTextField( FieldPtr field, const char *text );
 static Boolean FormHasCategory( void );
 static Boolean FormHasTitle( void );
 static UInt16 FormForType( int type );
+static const PostAPI *PostAPIForType( int type );
 static void AddMarkup( Int16 res, const char *single, const char *front,
                        const char *back );
 
 /* XMLRPC helpers */
-static char *EscapeString( char *string );
-static Boolean IsXMLWhitespace( char ch );
-static char *SkipWhitespaceMatch( const char *source, const char *match );
+static Boolean PostResponseEvent( void *ctx, XREvent *event );
 
 /* Basic XMLRPC and HTTP interfacing */
-static void ParseFaultInfo( char *faultTag, FaultInfo *fault );
-static int ParseXMLRPCDecl( char *start, char **end );
-static int ParseXMLRPCResponse( char *response, FaultInfo *fault );
-static Boolean ReadWholeFile( const char *file, char *buffer, UInt32 length );
+static void UsersBlogsBuild( XRBuilder *builder, void *ctx );
+static void BloggerPostParams( XRBuilder *builder, void *ctx );
+static void MetaWeblogPostParams( XRBuilder *builder, void *ctx );
+static void PostBuild( XRBuilder *builder, void *ctx );
+static int PostBatch( URLTarget *target, PostContent *post,
+                      Boolean *posted, XRResult *fault );
 static int PostFormData( void );
+static void CredentialsChanged( void );
+static CredCache *EscapedCredentials( void );
+#if defined(HTTP_NETSIM)
+static void NetSimReport( void );
+#endif
 
 /* Init and cleanup */
 static void StartApp( void );
@@ -376,6 +377,22 @@ static void EndApp( void );
 
 /* Blog list handling */
 static void FreeBlogListInfo( int count );
+static Boolean TreeBlog( XRTree *tree, XRNodeRef ref, BlogEntry *blog );
+static void SaveBlogsFromTree( XRTree *tree, XRNodeRef list );
+
+/* Drafts */
+static Int16 DraftCompare( void *rec1, void *rec2, Int16 other,
+                           SortRecordInfoPtr info1, SortRecordInfoPtr info2,
+                           MemHandle appInfoH );
+static Boolean FindDraft( UInt32 id, UInt16 *index );
+static void LoadDraft( void );
+static void MarkDraftSaved( void );
+static void RemoveDraft( UInt32 id );
+static void SetDraftState( UInt16 state );
+static void ConvertDraftDB( void );
+static Int32 DraftFieldLength( const char *field, UInt32 limit );
+static void DraftListDraw( Int16 itemNum, RectangleType *bounds,
+                           Char **itemsText );
 
 /* Event handling */
 static void PostFormUpdateScrollbar( void );
@@ -388,6 +405,7 @@ static Boolean IdentityFormHandler( EventType *event );
 static Boolean CreateLinkFormHandler( EventType *event );
 static Boolean BlogLoadFormHandler( EventType *event );
 static Boolean BlogListFormHandler( EventType *event );
+static Boolean DraftListFormHandler( EventType *event );
 static Boolean ServerFormHandler( EventType *event );
 static Boolean ApplicationHandleEvent( EventType *event );
 
@@ -456,436 +474,315 @@ static void SetTextField( FieldPtr field, const char *text )
 
 
 /*
- * Name:   EscapeString()
- * Input:  string - text to apply escaping to
- * Output: a newly allocated string on success, NULL on failure
- * Desc:   Adds in special character sequences in the place of characters which
- *         can cause problems for XML parsing.  The return value is heap
- *         allocated and must be freed by the caller after a successfull 
- *         return.
+ * Name:   PostResponseEvent()
+ * Args:   ctx - Boolean set once the post is known to have worked
+ *         event - next part of the newPost response
+ * Return: true to stop reading the response
+ * Desc:   The response to a post is the new post's ID, so as soon as that
+ *         value turns up there's nothing left worth waiting for.  Faults
+ *         are picked out by the parser.
  */
 
-static char *EscapeString( char *string )
+static Boolean PostResponseEvent( void *ctx, XREvent *event )
 {
-    UInt16 unescapedLen;
-    UInt16 escapedLen;
-    UInt16 index;
-    UInt16 escapedIndex;
-    char *newString;
-    char convStr[maxStrIToALen];
-
-    unescapedLen = StrLen( string );
-    escapedLen = 0;
-
-    for ( index = 0; index < unescapedLen; index++ ) {
-        if ( (unsigned char)string[index] < (unsigned char)127 ) {
-            switch ( string[index] ) {
-                case '&':
-                    escapedLen += 5;
-                    break;
-
-                case '\'':
-                    escapedLen += 6;
-                    break;
-
-                case '<':
-                    escapedLen += 4;
-                    break;
-
-                case '>':
-                    escapedLen += 4;
-                    break;
-
-                case '"':
-                    escapedLen += 6;
-                    break;
-
-                default:
-                    escapedLen++;
-                    break;
-            }
-        } else {
-            escapedLen += 6;
-        }
-    }
-
-    newString = (char *)MemPtrNew( escapedLen + 1 ); /* NULL terminator */
-    if ( newString == NULL ) {
-        return NULL;
-    }
-
-    escapedIndex = 0; 
-    for ( index = 0; index < unescapedLen; index++ ) {
-        if ( (unsigned char)string[index] < (unsigned char)127 ) {
-            switch ( string[index] ) {
-                case '&':
-                    newString[escapedIndex++] = '&';
-                    newString[escapedIndex++] = 'a';
-                    newString[escapedIndex++] = 'm';
-                    newString[escapedIndex++] = 'p';
-                    newString[escapedIndex++] = ';';
-                    break;
-
-                case '\'':
-                    newString[escapedIndex++] = '&';
-                    newString[escapedIndex++] = 'a';
-                    newString[escapedIndex++] = 'p';
-                    newString[escapedIndex++] = 'o';
-                    newString[escapedIndex++] = 's';
-                    newString[escapedIndex++] = ';';
-                    break;
-
-                case '<':
-                    newString[escapedIndex++] = '&';
-                    newString[escapedIndex++] = 'l';
-                    newString[escapedIndex++] = 't';
-                    newString[escapedIndex++] = ';';
-                    break;
-
-                case '>':
-                    newString[escapedIndex++] = '&';
-                    newString[escapedIndex++] = 'g';
-                    newString[escapedIndex++] = 't';
-                    newString[escapedIndex++] = ';';
-                    break;
-
-                case '"':
-                    newString[escapedIndex++] = '&';
-                    newString[escapedIndex++] = 'q';
-                    newString[escapedIndex++] = 'u';
-                    newString[escapedIndex++] = 'o';
-                    newString[escapedIndex++] = 't';
-                    newString[escapedIndex++] = ';';
-                    break;
-
-                default:
-                    newString[escapedIndex++] = string[index];
-                    break;
-            }
-        } else {
-            StrIToA( convStr, (unsigned char)string[index] );
-            newString[escapedIndex++] = '&';
-            newString[escapedIndex++] = '#';
-            newString[escapedIndex++] = convStr[0];
-            newString[escapedIndex++] = convStr[1];
-            newString[escapedIndex++] = convStr[2];
-            newString[escapedIndex++] = ';';
+    if ( event->depth == 0 ) {
+        if ( (event->kind == XRE_VALUE) || 
+                (event->kind == XRE_STRUCT_BEGIN) ) {
+            *(Boolean *)ctx = true;
+            return true;
         }
     }
-    newString[escapedIndex++] = '\0';
 
-    return newString;
+    return false;
 }
 
 
 /*
- * Desc:   Returns true if the character given is a whitespace character.
  */
 
-static Boolean IsXMLWhitespace( char ch )
+static void ConditionalUnlockHandle( MemHandle handle )
 {
-    switch ( ch ) {
-        case '\r':
-        case '\n':
-        case ' ':
-        case '\t':
-            return true;
-            break;
-
-        default:
-            return false;
-            break;
+    if ( handle != NULL ) {
+        MemHandleUnlock( handle );
     }
 }
 
 
 /*
-   Skip any leading whitespace and attempt to find the end of 'matchString'
-   if we hit non-whitespace that doesn't match the given input, return null.
-   Otherwise return a pointer to the next byte after the matching string.
  */
 
-static char *SkipWhitespaceMatch( const char *source, const char *match )
+static char *StrDup( char *string )
 {
-    char *search;
-    Int32 length;
-
-    search = (char *)source;
-
-    while ( IsXMLWhitespace( *search ) ) {
-        search++;
-    }
+    int strSize;
+    char *returnStr;
 
-    length = StrLen( match );
-    if ( StrNCaselessCompare( search, match, length ) == 0 ) {
-        return search + length;
+    strSize = StrLen( string ) + 1;
+    returnStr = MemPtrNew( strSize );
+    if ( returnStr == NULL ) {
+        return NULL;
     }
 
-    return NULL;
+    StrCopy( returnStr, string );
+    return returnStr;
 }
 
 
 /*
+ * Name:   UsersBlogsBuild()
+ * Args:   builder - where to write the request
+ *         ctx - unused
+ * Return: none
+ * Desc:   blogger.getUsersBlogs, for the blog list.
  */
 
-static void CopyUpTo( const char *start, const char *marker, FaultInfo *fault )
+static void UsersBlogsBuild( XRBuilder *builder, void *ctx )
 {
-    int strIndx;
-
-    strIndx = 0;
-
-    while ( StrNCompare( start + strIndx, marker, StrLen( marker ) ) != 0 ) {
-        fault->string[strIndx] = start[strIndx];
-        if ( start[strIndx] == '\0' ) {
-            return;
-        }
-        strIndx++;
-        if ( strIndx == (FAULT_STR_LEN - 1) ) {
-            fault->string[strIndx] = '\0';
-        }
-    }
-
-    fault->string[strIndx] = '\0';
+    CredCache *cred;
+
+    cred = EscapedCredentials();
+    XRCallBegin( builder, "blogger.getUsersBlogs" );
+    XRString( builder, VAGABLOG_ID, false );
+    XRString( builder, cred->name, false );
+    XRString( builder, cred->pass, false );
+    XRCallEnd( builder );
 }
 
 
 /*
+ * Name:   BloggerPostParams()
+ * Args:   builder - where to write the request
+ *         ctx - the PostContent
+ * Return: none
+ * Desc:   Params for blogger.newPost.  The Blogger API has nowhere to put a
+ *         title or category, so the servers that take one there look for
+ *         them as escaped pseudo tags at the front of the body.  Empty
+ *         ones are left out.
  */
 
-static void FindNextValue( char *begin, FaultInfo *fault )
+static void BloggerPostParams( XRBuilder *builder, void *ctx )
 {
-    char *endName;
-    char *afterValue;
-    char *afterString;
-    char *testLessThan;
-
-    endName = StrStr( begin, gXMLRPCNameEnd );
-    if ( endName == NULL ) {
-        StrCopy( fault->string, "Unable to find fault string" );
-        return;
+    PostContent *post;
+    CredCache *cred;
+
+    post = (PostContent *)ctx;
+    cred = EscapedCredentials();
+    XRString( builder, VAGABLOG_ID, false );
+    XRString( builder, gPrefs.blogID, true );
+    XRString( builder, cred->name, false );
+    XRString( builder, cred->pass, false );
+
+    XRStringBegin( builder );
+    if ( post->title[0] != '\0' ) {
+        XRRawLiteral( builder, "&lt;title&gt;" );
+        XRText( builder, post->title, true );
+        XRRawLiteral( builder, "&lt;/title&gt;" );
     }
-    endName += StrLen( gXMLRPCNameEnd );
-
-    afterValue = SkipWhitespaceMatch( endName, gXMLRPCValueStart );
-    if ( afterValue == NULL ) {
-        StrCopy( fault->string, "Unable to find fault string" );
-        return;
+    if ( post->category[0] != '\0' ) {
+        XRRawLiteral( builder, "&lt;category&gt;" );
+        XRText( builder, post->category, true );
+        XRRawLiteral( builder, "&lt;/category&gt;" );
     }
+    XRText( builder, post->body, true );
+    XRStringEnd( builder );
 
-    afterString = SkipWhitespaceMatch( afterValue, gXMLRPCStringStart );
-    if ( afterString == NULL ) {
-        /* The <string> tag might just have been left off */
-        testLessThan = SkipWhitespaceMatch( afterValue, "<" );
-        if ( testLessThan != NULL ) {
-            StrCopy( fault->string, "Unable to find fault string" );
-            return;
-        }
-        CopyUpTo( afterValue, gXMLRPCValueEnd, fault );
-    } else {
-        CopyUpTo( afterString, gXMLRPCStringEnd, fault );
-    }
+    XRBoolean( builder, post->publish );
 }
 
 
 /*
+ * Name:   MetaWeblogPostParams()
+ * Args:   builder - where to write the request
+ *         ctx - the PostContent
+ * Return: none
+ * Desc:   Params for metaWeblog.newPost, with the title and category as
+ *         members of the post struct and the body as its description.
  */
 
-static void ParseFaultInfo( char *faultTag, FaultInfo *fault )
+static void MetaWeblogPostParams( XRBuilder *builder, void *ctx )
 {
-    char *afterValue;
-    char *afterStruct;
-    char *afterMember;
-    char *beginElem;
-    char *beginName;
-
-    afterValue = SkipWhitespaceMatch( faultTag, gXMLRPCValueStart );
-    if ( afterValue == NULL ) {
-        StrCopy( fault->string, "Unable to find fault string" );
-        return;
+    PostContent *post;
+    CredCache *cred;
+
+    post = (PostContent *)ctx;
+    cred = EscapedCredentials();
+    XRString( builder, gPrefs.blogID, true );
+    XRString( builder, cred->name, false );
+    XRString( builder, cred->pass, false );
+
+    XRStructBegin( builder );
+    if ( post->title[0] != '\0' ) {
+        XRMember( builder, "title" );
+        XRString( builder, post->title, true );
     }
-    afterStruct = SkipWhitespaceMatch( afterValue, gXMLRPCStructStart );
-    if ( afterStruct == NULL ) {
-        StrCopy( fault->string, "Unable to find fault string" );
-        return;
+    if ( post->category[0] != '\0' ) {
+        XRMember( builder, "categories" );
+        XRArrayBegin( builder );
+        XRString( builder, post->category, true );
+        XRArrayEnd( builder );
     }
+    XRMember( builder, "description" );
+    XRString( builder, post->body, true );
+    XRStructEnd( builder );
 
-    beginElem = afterStruct;
-
-    while ( (afterMember = SkipWhitespaceMatch( beginElem, 
-                                                gXMLRPCMemberStart ))
-            != NULL ) {
-        beginName = SkipWhitespaceMatch( afterMember, gXMLRPCNameStart );
-        if ( beginName == NULL ) {
-            beginElem = StrStr( beginElem, gXMLRPCMemberEnd );
-            if ( beginElem == NULL ) {
-                StrCopy( fault->string, "Unable to find fault string" );
-                return;
-            }
-            beginElem += StrLen( gXMLRPCMemberEnd );
-        } else {
-            if ( StrNCompare( beginName, gXMLRPCFaultName, 
-                              StrLen( gXMLRPCFaultName ) ) == 0 ) {
-                FindNextValue( beginName, fault );
-                return;
-            } else {
-                beginElem = StrStr( beginElem, gXMLRPCMemberEnd );
-                if ( beginElem == NULL ) {
-                    StrCopy( fault->string, "Unable to find fault string" );
-                    return;
-                }
-                beginElem += StrLen( gXMLRPCMemberEnd );
-            }
-        }
-    }
+    XRBoolean( builder, post->publish );
 }
 
 
 /*
+ * Name:   PostBuild()
+ * Args:   builder - where to write the request
+ *         ctx - the PostContent
+ * Return: none
+ * Desc:   A post as a request on its own.
  */
 
-static int ParseXMLRPCDecl( char *start, char **end )
+static void PostBuild( XRBuilder *builder, void *ctx )
 {
-    char *afterDecl;
-    char *endDecl;
-
-    if ( StrNCaselessCompare( start, gXMLDeclStart, StrLen( gXMLDeclStart ) )
-            != 0 ) {
-        return -1;
-    }
-
-    afterDecl = start + StrLen( gXMLDeclStart );
-    endDecl = StrStr( afterDecl, gXMLDeclEnd );
-    if ( endDecl == NULL ) {
-        return -1;
-    }
+    PostContent *post;
 
-    *end = endDecl + StrLen( gXMLDeclEnd );
-    return 0;
+    post = (PostContent *)ctx;
+    XRCallBegin( builder, post->api->method );
+    post->api->params( builder, ctx );
+    XRCallEnd( builder );
 }
 
 
 /*
-   Returns 0 if there was no fault, negative if there was.  If there was a
-   fault the info is coppied into the fault struct (fault code and string)
+ * Name:   CredentialsChanged()
+ * Args:   none
+ * Return: none
+ * Desc:   Called whenever gPrefs.name or gPrefs.pass are set, rebuilds the
+ *         escaped copies.
  */
 
-static int ParseXMLRPCResponse( char *response, FaultInfo *fault )
+static void CredentialsChanged( void )
 {
-    char *methodResponse;
-    char *afterResponse;
-    char *params;
-    char *faultTag;
-
-    if ( ParseXMLRPCDecl( response, &methodResponse ) != 0 ) {
-        fault->code = 0;
-        StrCopy( fault->string, "Unable to find XML declaration" );
-        return -1;
-    }
-
-    afterResponse = SkipWhitespaceMatch( methodResponse, "<methodResponse>" );
-    if ( afterResponse == NULL ) {
-        fault->code = 0;
-        StrCopy( fault->string, "Missing method response tag" );
-        return -1;
-    }
-
-    params = SkipWhitespaceMatch( afterResponse, "<params>" );
-    if ( params != NULL ) {
-        return 0;
-    }
-
-    faultTag = SkipWhitespaceMatch( afterResponse, gXMLRPCFaultStart );
-    if ( faultTag != NULL ) {
-        ParseFaultInfo( faultTag, fault );
-        return -1;
-    }
-
-    fault->code = 0;
-    StrCopy( fault->string, "Unexpected tag after method response" );
-
-    return -1;
+    gCredVersion++;
+    EscapedCredentials();
 }
 
 
 /*
+ * Name:   EscapedCredentials()
+ * Args:   none
+ * Return: the escaped user name and password
+ * Desc:   The cache is sized for the longest name and password the prefs
+ *         can hold, so the escaping can't run out of room.
  */
 
-static Boolean ReadWholeFile( const char *file, char *buffer, UInt32 length )
+static CredCache *EscapedCredentials( void )
 {
-    void *fd;
-    UInt32 filledBytes;
-    Int32 thisRead;
-
-    fd = FileOpen( 0, file, 'DATA', 'BRWS', fileModeReadOnly, NULL );
-    if ( fd == NULL ) {
-        return false;
-    }
-
-    filledBytes = 0;
-    while ( (filledBytes < (length - 1)) &&
-            ((thisRead = FileRead( fd, buffer + filledBytes, 1, 
-                           (length - 1) - filledBytes, NULL )) != 0 ) ) {
-        filledBytes += thisRead;
-    }
-
-    buffer[filledBytes] = '\0';
-
-    if ( !FileEOF( fd ) ) {
-        FileClose( fd );
-        return false;
+    if ( gCredCache.version != gCredVersion ) {
+        XREscapeBounded( gPrefs.name, gCredCache.name, 
+                         sizeof( gCredCache.name ) );
+        XREscapeBounded( gPrefs.pass, gCredCache.pass, 
+                         sizeof( gCredCache.pass ) );
+        gCredCache.version = gCredVersion;
     }
 
-    FileClose( fd );
-    return true;
+    return &gCredCache;
 }
 
 
+#if defined(HTTP_NETSIM)
 /*
+ * Name:   NetSimReport()
+ * Args:   none
+ * Return: none
+ * Desc:   Shows the counters from the request that just finished, so the
+ *         scenarios and settings can be compared.  Times are in ticks of
+ *         the simulated clock.
  */
 
-static void ConditionalUnlockHandle( MemHandle handle )
+static void NetSimReport( void )
 {
-    if ( handle != NULL ) {
-        MemHandleUnlock( handle );
-    }
+    HTTPStats stats;
+    char report[NETSIM_REPORT_LEN];
+
+    HTTPLibGetStats( &stats );
+    StrPrintF( report, "Sent %lu bytes, received %lu.  First byte after "
+               "%lu ticks, done after %lu.  %lu saves.", stats.bytesSent,
+               stats.bytesReceived, stats.firstByteTicks, stats.totalTicks,
+               stats.storageWrites );
+    FrmCustomAlert( NetStatsAlert, report, NULL, NULL );
 }
+#endif
 
 
 /*
+ * Name:   PostBatch()
+ * Args:   target - server to post to
+ *         post - what to post
+ *         posted - set if the post went through
+ *         fault - set to the post's fault, if it got one
+ * Return: 0 if the server answered, -1 if it couldn't be reached, -2 if
+ *         there's no memory for the batch
+ * Desc:   Sends the post with a blogger.getUsersBlogs behind it, so the
+ *         saved blog list is brought up to date in the same round trip
+ *         when the server takes system.multicall.  The list is only saved
+ *         if it came back.
  */
 
-static char *StrDup( char *string )
+static int PostBatch( URLTarget *target, PostContent *post,
+                      Boolean *posted, XRResult *fault )
 {
-    int strSize;
-    char *returnStr;
-
-    strSize = StrLen( string ) + 1;
-    returnStr = MemPtrNew( strSize );
-    if ( returnStr == NULL ) {
-        return NULL;
+    XRParam usersBlogs[3];
+    XRCall calls[2];
+    XRBatch batch;
+    CredCache *cred;
+    char *buffer;
+    int status;
+    UInt16 i;
+
+    buffer = (char *)MemPtrNew( BATCH_TREE_SIZE );
+    if ( buffer == NULL ) {
+        return -2;
     }
 
-    StrCopy( returnStr, string );
-    return returnStr;
-}
-
+    cred = EscapedCredentials();
+    usersBlogs[0].text = VAGABLOG_ID;
+    usersBlogs[1].text = cred->name;
+    usersBlogs[2].text = cred->pass;
+    for ( i = 0; i < 3; i++ ) {
+        usersBlogs[i].type = XRT_STRING;
+        usersBlogs[i].escape = false;
+    }
 
-/*
- */
+    MemSet( calls, sizeof( calls ), 0 );
+    calls[0].method = post->api->method;
+    calls[0].build = post->api->params;
+    calls[0].ctx = post;
+    calls[1].method = "blogger.getUsersBlogs";
+    calls[1].params = usersBlogs;
+    calls[1].paramCount = 3;
+
+    batch.calls = calls;
+    batch.callCount = 2;
+    batch.multicall = &gMulticall;
+
+    fault->fault = false;
+    status = XRBatchRun( target, &batch, buffer, BATCH_TREE_SIZE );
+    if ( status == -1 ) {
+        MemPtrFree( buffer );
+        return -1;
+    }
 
-static char *TaggedString( const char *beginTag, char *content, 
-                           const char *endTag )
-{
-    int strSize;
-    char *returnStr;
+    /*
+     * If the response couldn't be read the post is still known to have
+     * worked when its own answer came back before the trouble started.
+     */
+    if ( !calls[0].result.fault ) {
+        *posted = true;
+    } else if ( status == 0 ) {
+        *fault = calls[0].result;
+    }
 
-    strSize = StrLen( beginTag ) + StrLen( content ) + StrLen( endTag ) + 1;
-    returnStr = MemPtrNew( strSize );
+    if ( !calls[1].result.fault ) {
+        SaveBlogsFromTree( &(batch.tree), calls[1].value );
+    }
 
-    StrCopy( returnStr, beginTag );
-    StrCat( returnStr, content );
-    StrCat( returnStr, endTag );
-    return returnStr;
+    MemPtrFree( buffer );
+    return 0;
 }
 
 
@@ -906,19 +803,16 @@ static int PostFormData( void )
     char *catFldText;
     FormPtr statusForm;
     FieldPtr statusField;
-    char *postText;
     URLTarget target;
     int retValue;
-    char *escaped;
-    char *escapedCat;
-    char *escapedTitle;
-    char *escapedName;
-    char *escapedPass;
-    char *catEntry;
-    char *titleEntry;
-    FaultInfo fault;
+    XRResult fault;
+    XRParser parser;
+    Boolean posted;
     Int16 postres;
-    int publishFld;
+    int status;
+    PostContent post;
+    XRBuild build;
+    HTTPBody body;
 
     form = FrmGetFormPtr( FormForType( gPrefs.blogType ) );
     postField = GetObjectPtr( form, BlogEntryFld );
@@ -964,100 +858,16 @@ static int PostFormData( void )
     SetTextField( statusField, "Formatting request" );
     FldDrawField( statusField );
 
-    escaped = EscapeString( postFldText );
-    if ( escaped == NULL ) {
-        MemHandleUnlock( postHandle );
-        ConditionalUnlockHandle( titleHandle );
-        ConditionalUnlockHandle( catHandle );
-        return -2;
-    }
-    MemHandleUnlock( postHandle );
-
-    if ( titleHandle == NULL ) {
-        titleEntry = StrDup( "" );
-    } else {
-        if ( StrLen( titleFldText ) == 0 ) {
-            titleEntry = StrDup( "" );
-        } else {
-            escapedTitle = EscapeString( titleFldText );
-            if ( escapedTitle == NULL ) {
-                titleEntry = NULL;
-            } else {
-                titleEntry = TaggedString( gTitleBegin, escapedTitle,
-                                           gTitleEnd );
-                MemPtrFree( escapedTitle );
-            }
-        }
-        MemHandleUnlock( titleHandle );
-    }
-
-    if ( titleEntry == NULL ) {
-        MemPtrFree( escaped );
-        ConditionalUnlockHandle( catHandle );
-    }
-
-    if ( catHandle == NULL ) {
-        catEntry = StrDup( "" );
-    } else {
-        if ( StrLen( catFldText ) == 0 ) {
-            catEntry = StrDup( "" );
-        } else {
-            escapedCat = EscapeString( catFldText );
-            if ( escapedCat == NULL ) {
-                catEntry = NULL;
-            } else {
-                catEntry = TaggedString( gCatBegin, escapedCat, gCatEnd );
-                MemPtrFree( escapedCat );
-            }
-        }
-        MemHandleUnlock( catHandle );
-    }
-    if ( catEntry == NULL ) {
-        MemPtrFree( escaped );
-        MemPtrFree( titleEntry );
-    }
-
-    postText = (char *)MemPtrNew( 6000 );
-    if ( postText == NULL ) {
-        MemPtrFree( escaped );
-        MemPtrFree( titleEntry );
-        MemPtrFree( catEntry );
-        return -3;
-    }
-
-    escapedName = EscapeString( gPrefs.name );
-    if ( escapedName == NULL ) {
-        MemPtrFree( escaped );
-        MemPtrFree( titleEntry );
-        MemPtrFree( catEntry );
-        MemPtrFree( postText );
-        return -4;
-    }
-
-    escapedPass = EscapeString( gPrefs.pass );
-    if ( escapedPass == NULL ) {
-        MemPtrFree( escaped );
-        MemPtrFree( titleEntry );
-        MemPtrFree( catEntry );
-        MemPtrFree( postText );
-        MemPtrFree( escapedName );
-        return -5;
-    }
-
-    if ( gPrefs.publishFlag == PUB_LATER ) {
-        publishFld = 0;
-    } else {
-        publishFld = 1;
-    }
-
-    StrPrintF( postText, gNewPostReq, gPrefs.blogID, escapedName, escapedPass,
-               titleEntry, catEntry, escaped, publishFld );
-
-    MemPtrFree( escaped );
-    MemPtrFree( titleEntry );
-    MemPtrFree( catEntry );
-    MemPtrFree( escapedName );
-    MemPtrFree( escapedPass );
+    /*
+     * Nothing is copied: the text is escaped straight out of the fields'
+     * handles into the send window while the request goes out, so they
+     * stay locked until the post is done.
+     */
+    post.api = PostAPIForType( gPrefs.blogType );
+    post.title = titleFldText;
+    post.category = catFldText;
+    post.body = postFldText;
+    post.publish = (gPrefs.publishFlag != PUB_LATER);
 
     target.host = gPrefs.host;
     target.port = StrAToI( gPrefs.port );
@@ -1066,38 +876,64 @@ static int PostFormData( void )
     SetTextField( statusField, "Transmitting" );
     FldDrawField( statusField );
 
+    /*
+     * Unless the server is known not to take batches the blog list is
+     * refreshed along with the post.  Otherwise the response is parsed as
+     * it comes in, and reading stops as soon as the new post's ID has gone
+     * by.
+     */
     retValue = -1;
-    if ( (postres = HTTPPost( &target, postText, (char *)gTempDBName )) == HTTPErr_OK ) {
-        SetTextField( statusField, "Processing Response" );
-        FldDrawField( statusField );
-        if ( ReadWholeFile( gTempDBName, postText, 6000 ) ) {
-            if ( ParseXMLRPCResponse( postText, &fault ) == 0 ) {
-                FrmAlert( PostSuccessAlert );
-                retValue = 0;
-                
-                if ( gPrefs.postAction == PA_CLEAR_TEXT ) {
-                    SetTextField( postField, "" );
-                    if ( titleField != NULL ) {
-                        SetTextField( titleField, "" );
-                    }
-                    if ( catField != NULL ) {
-                        SetTextField( catField, "" );
-                    }
-                }
-            } else {
-                FrmCustomAlert( PostErrAlert, fault.string, NULL, NULL );
-            }
+    posted = false;
+    status = -2;
+    if ( gMulticall != XR_MULTICALL_NO ) {
+        status = PostBatch( &target, &post, &posted, &fault );
+    }
+    if ( status == -2 ) {
+        build.build = PostBuild;
+        build.ctx = &post;
+        XRBuildBody( &build, &body );
+
+        XRParserStart( &parser, PostResponseEvent, &posted, &fault );
+        postres = HTTPPostBody( &target, &body, NULL, XRParserWatch,
+                                &parser );
+        status = (postres == HTTPErr_OK) ? 0 : -1;
+    }
+#if defined(HTTP_NETSIM)
+    NetSimReport();
+#endif
+
+    MemHandleUnlock( postHandle );
+    ConditionalUnlockHandle( titleHandle );
+    ConditionalUnlockHandle( catHandle );
 
+    if ( status != 0 ) {
+        FrmCustomAlert( PostErrAlert, "Unable to contact server", NULL, NULL );
+    } else if ( posted ) {
+        FrmAlert( PostSuccessAlert );
+        retValue = 0;
+
+        /* Once it's cleared away the draft isn't needed any more */
+        if ( gPrefs.postAction == PA_CLEAR_TEXT ) {
+            SetTextField( postField, "" );
+            if ( titleField != NULL ) {
+                SetTextField( titleField, "" );
+            }
+            if ( catField != NULL ) {
+                SetTextField( catField, "" );
+            }
+            RemoveDraft( gDraftID );
+            gDraftID = 0;
+            gDraftState = DS_UNSENT;
         } else {
-            FrmCustomAlert( PostErrAlert, "Out of memory processing response",
-                            NULL, NULL );
+            SetDraftState( DS_POSTED );
         }
+    } else if ( fault.fault ) {
+        FrmCustomAlert( PostErrAlert, fault.text, NULL, NULL );
     } else {
-        FrmCustomAlert( PostErrAlert, "Unable to contact server", NULL, NULL );
+        FrmCustomAlert( PostErrAlert, "Unexpected response from server",
+                        NULL, NULL );
     }
 
-    MemPtrFree( postText );
-
     return retValue;
 }
 
@@ -1445,8 +1281,14 @@ static void StartApp( void )
         version = PrefGetAppPreferences( gCreator, gAppPrefID, &gPrefs,
                                          &prefsSize, true );
     }
+    CredentialsChanged();
 
     HTTPLibStart( 'VBlg', StrAToI( gPrefs.timeout ) );
+#if defined(HTTP_NETSIM)
+    HTTPLibSetTransport( NetSimLoadScenario( NETSIM_SCENARIO ) );
+    HTTPLibSetWriteBlock( NETSIM_WRITE_BLOCK );
+    HTTPLibSetNoDelay( NETSIM_NODELAY );
+#endif
 
     gDBRef = DmOpenDatabaseByTypeCreator( gDBType, gCreator, dmModeReadWrite );
     if ( !gDBRef ) { 
@@ -1464,6 +1306,13 @@ static void StartApp( void )
         }
     }
 
+    prefsSize = sizeof(gDraftID);
+    if ( PrefGetAppPreferences( gCreator, gDraftPrefID, &gDraftID, &prefsSize,
+                                true ) == noPreferenceFound ) {
+        gDraftID = 0;
+    }
+    ConvertDraftDB();
+
     gPrefDBRef = DmOpenDatabaseByTypeCreator( gPrefDBType, gCreator,
                                               dmModeReadWrite );
     if ( !gPrefDBRef ) {
@@ -1494,7 +1343,11 @@ static void EndApp( void )
     PrefSetAppPreferences( gCreator, gAppPrefID, gAppPrefVersion, &gPrefs,
                            sizeof(gPrefs), true );
 
+    /* Closing the post form can save a new draft, so this goes after */
     FrmCloseAllForms();
+    PrefSetAppPreferences( gCreator, gDraftPrefID, gDraftPrefVersion,
+                           &gDraftID, sizeof(gDraftID), true );
+
     HTTPLibStop();
     if ( gDBRef != NULL ) {
         DmCloseDatabase( gDBRef );
@@ -1650,18 +1503,26 @@ static void ParsePostFields( char *record, UInt32 length )
 
 
 /*
+ * Name:   UnserializeDBRec()
+ * Args:   hndl - record of the draft to show
+ * Return: none
+ * Desc:   Fills in the post form from a draft.
  */
 
 static void UnserializeDBRec( MemHandle hndl )
 {
     UInt32 recSize;
-    char *fieldText;
+    char *record;
+    DraftHeader *header;
 
     recSize = MemHandleSize( hndl );
-    fieldText = MemHandleLock( hndl );
+    record = MemHandleLock( hndl );
+    header = (DraftHeader *)record;
 
-    if ( StrLen( fieldText ) != (recSize - 1) ) {
-        ParsePostFields( fieldText, recSize );
+    if ( (recSize > sizeof(DraftHeader)) && 
+            (header->size == (recSize - sizeof(DraftHeader))) ) {
+        gDraftState = header->state;
+        ParsePostFields( record + sizeof(DraftHeader), header->size );
     }
 
     MemHandleUnlock( hndl );
@@ -1669,6 +1530,14 @@ static void UnserializeDBRec( MemHandle hndl )
 
 
 /*
+ * Name:   SerializeDBRec()
+ * Args:   none
+ * Return: none
+ * Desc:   Saves the post form into the draft being edited, or a new one if
+ *         there isn't one yet, and moves it to the top of the list.
+ *         Nothing is written unless a field has been changed, so just
+ *         looking at a draft doesn't make it the newest.  A draft with no
+ *         text left in it is removed.
  */
 
 static void SerializeDBRec( void )
@@ -1687,6 +1556,9 @@ static void SerializeDBRec( void )
     UInt32 recOff;
     MemHandle dbHandle;
     char *recText;
+    DraftHeader header;
+    DraftHeader *old;
+    Boolean exists;
 
     if ( FormHasTitle() ) {
         titleField = GetCurrFormObjPtr( BlogTitleFld );
@@ -1717,6 +1589,12 @@ static void SerializeDBRec( void )
     postField = GetCurrFormObjPtr( BlogEntryFld );
     postHndl = FldGetTextHandle( postField );
 
+    if ( !FldDirty( postField ) && 
+            ((titleField == NULL) || !FldDirty( titleField )) &&
+            ((catField == NULL) || !FldDirty( catField )) ) {
+        return;
+    }
+
     if ( titleHndl == NULL ) {
         saveSize = 1;
         titleText = NULL;
@@ -1741,28 +1619,62 @@ static void SerializeDBRec( void )
         saveSize += (StrLen( postText ) + 1);
     }
 
-    index = 0;
-    if ( DmNumRecords( gDBRef ) > 0 ) {
-        dbHandle = DmResizeRecord( gDBRef, index, saveSize );
+    exists = FindDraft( gDraftID, &index );
+
+    /* Can't happen from the form's fields, but 'size' would wrap */
+    if ( saveSize > DRAFT_MAX_SIZE ) {
+        goto unlock_fields;
+    }
+
+    /* Just the three terminators */
+    if ( saveSize == 3 ) {
+        RemoveDraft( gDraftID );
+        gDraftID = 0;
+        gDraftState = DS_UNSENT;
+        MarkDraftSaved();
+        goto unlock_fields;
+    }
+
+    header.modified = TimGetSeconds();
+    header.created = header.modified;
+    StrCopy( header.blogID, gPrefs.blogID );
+    header.state = gDraftState;
+    header.size = saveSize;
+
+    if ( exists ) {
+        dbHandle = DmQueryRecord( gDBRef, index );
+        if ( MemHandleSize( dbHandle ) >= sizeof(DraftHeader) ) {
+            old = (DraftHeader *)MemHandleLock( dbHandle );
+            header.created = old->created;
+            MemHandleUnlock( dbHandle );
+        }
+
+        dbHandle = DmResizeRecord( gDBRef, index, 
+                                   sizeof(DraftHeader) + saveSize );
         if ( dbHandle == NULL ) {
             goto unlock_fields;
         }
         dbHandle = DmGetRecord( gDBRef, index );
     } else {
-        dbHandle = DmNewRecord( gDBRef, &index, saveSize );
+        index = DmFindSortPosition( gDBRef, &header, NULL, DraftCompare, 0 );
+        dbHandle = DmNewRecord( gDBRef, &index, 
+                                sizeof(DraftHeader) + saveSize );
         if ( dbHandle == NULL ) {
             goto unlock_fields;
         }
+        DmRecordInfo( gDBRef, index, NULL, &gDraftID, NULL );
     }
 
-    recOff = 0;
+    recOff = sizeof(DraftHeader);
     recText = MemHandleLock( dbHandle );
     if ( recText != NULL ) {
+        DmWrite( recText, 0, &header, sizeof(DraftHeader) );
+
         if ( titleHndl == NULL ) {
-            DmWrite( recText, 0, "", 1 );
+            DmWrite( recText, recOff, "", 1 );
             recOff += 1;
         } else {
-            DmWrite( recText, 0, titleText, (StrLen( titleText ) + 1) );
+            DmWrite( recText, recOff, titleText, (StrLen( titleText ) + 1) );
             recOff += (StrLen( titleText ) + 1);
         }
 
@@ -1785,7 +1697,13 @@ static void SerializeDBRec( void )
         MemHandleUnlock( dbHandle );
     }
 
-    DmReleaseRecord( gDBRef, index, false );
+    DmReleaseRecord( gDBRef, index, true );
+    MarkDraftSaved();
+
+    /* It was just changed, so it's the newest and goes to the top */
+    if ( exists && (index != 0) ) {
+        DmMoveRecord( gDBRef, index, 0 );
+    }
 
 unlock_fields:
     if ( titleHndl != NULL ) {
@@ -1801,36 +1719,234 @@ unlock_fields:
 
 
 /*
+ * Name:   DraftCompare()
+ * Args:   rec1, rec2 - draft records, or just their headers
+ * Return: < 0 if rec1 goes first, > 0 if rec2 does, 0 if it doesn't matter
+ * Desc:   The sort function for DmFindSortPosition(), newest first.  Only
+ *         the header is looked at, so a header on its own can be passed
+ *         in to find where a draft should go.
  */
 
-static Boolean FormHasCategory( void )
+static Int16 DraftCompare( void *rec1, void *rec2, Int16 other,
+                           SortRecordInfoPtr info1, SortRecordInfoPtr info2,
+                           MemHandle appInfoH )
 {
-    switch ( FrmGetActiveFormID() ) {
-        case MinimalForm:
-            return( false );
-            break;
-
-        case MainForm:
-            return( true );
-            break;
+    UInt32 modified1;
+    UInt32 modified2;
 
-        default:
-            break;
+    modified1 = ((DraftHeader *)rec1)->modified;
+    modified2 = ((DraftHeader *)rec2)->modified;
+    if ( modified1 > modified2 ) {
+        return -1;
+    } else if ( modified1 < modified2 ) {
+        return 1;
     }
 
-    return( false );
+    return 0;
 }
 
 
 /*
+ * Name:   FindDraft()
+ * Args:   id - unique ID of a draft's record, 0 for none
+ *         index - set to where the record is now
+ * Return: true if the draft is there
  */
 
-static Boolean FormHasTitle( void )
+static Boolean FindDraft( UInt32 id, UInt16 *index )
 {
-    switch ( FrmGetActiveFormID() ) {
-        case MinimalForm:
-            return( false );
-            break;
+    if ( (gDBRef == NULL) || (id == 0) ) {
+        return false;
+    }
+
+    return ( DmFindRecordByID( gDBRef, id, index ) == errNone );
+}
+
+
+/*
+ * Name:   LoadDraft()
+ * Args:   none
+ * Return: none
+ * Desc:   Shows the draft being edited in the post form.  If it's gone the
+ *         form is left empty for a new one.
+ */
+
+static void LoadDraft( void )
+{
+    UInt16 index;
+    MemHandle dbHandle;
+
+    gDraftState = DS_UNSENT;
+    if ( !FindDraft( gDraftID, &index ) ) {
+        gDraftID = 0;
+        return;
+    }
+
+    dbHandle = DmQueryRecord( gDBRef, index );
+    if ( dbHandle != NULL ) {
+        UnserializeDBRec( dbHandle );
+    }
+    MarkDraftSaved();
+}
+
+
+/*
+ * Name:   MarkDraftSaved()
+ * Args:   none
+ * Return: none
+ * Desc:   Clears the changed flags on the post form's fields, they're how
+ *         SerializeDBRec() knows whether there's anything to save.
+ */
+
+static void MarkDraftSaved( void )
+{
+    if ( FormHasTitle() ) {
+        FldSetDirty( GetCurrFormObjPtr( BlogTitleFld ), false );
+    }
+    if ( FormHasCategory() ) {
+        FldSetDirty( GetCurrFormObjPtr( BlogCategoryFld ), false );
+    }
+    FldSetDirty( GetCurrFormObjPtr( BlogEntryFld ), false );
+}
+
+
+/*
+ * Name:   RemoveDraft()
+ * Args:   id - unique ID of the draft's record, 0 for none
+ * Return: none
+ */
+
+static void RemoveDraft( UInt32 id )
+{
+    UInt16 index;
+
+    if ( FindDraft( id, &index ) ) {
+        DmRemoveRecord( gDBRef, index );
+    }
+}
+
+
+/*
+ * Name:   SetDraftState()
+ * Args:   state - one of the DS_ values
+ * Return: none
+ * Desc:   For the draft being edited.  It's remembered for when the draft
+ *         is next saved as well, in case it hasn't been yet.
+ */
+
+static void SetDraftState( UInt16 state )
+{
+    UInt16 index;
+    MemHandle dbHandle;
+    char *recText;
+
+    gDraftState = state;
+    if ( !FindDraft( gDraftID, &index ) ) {
+        return;
+    }
+
+    dbHandle = DmGetRecord( gDBRef, index );
+    if ( dbHandle == NULL ) {
+        return;
+    }
+    if ( MemHandleSize( dbHandle ) >= sizeof(DraftHeader) ) {
+        recText = MemHandleLock( dbHandle );
+        DmWrite( recText, OffsetOf( DraftHeader, state ), &state, 
+                 sizeof(state) );
+        MemHandleUnlock( dbHandle );
+    }
+    DmReleaseRecord( gDBRef, index, true );
+}
+
+
+/*
+ * Name:   ConvertDraftDB()
+ * Args:   none
+ * Return: none
+ * Desc:   Before there were drafts the post being written was all of
+ *         record 0, with no header.  It becomes the first draft, and the
+ *         one being edited.  The database version says whether this has
+ *         been done, it's left alone to try again next time if there
+ *         isn't room.
+ */
+
+static void ConvertDraftDB( void )
+{
+    LocalID dbID;
+    UInt16 cardNo;
+    UInt16 version;
+    MemHandle oldHandle;
+    MemHandle dbHandle;
+    UInt32 oldSize;
+    UInt16 index;
+    char *oldText;
+    char *recText;
+    DraftHeader header;
+
+    if ( DmOpenDatabaseInfo( gDBRef, &dbID, NULL, NULL, &cardNo, 
+                             NULL ) != errNone ) {
+        return;
+    }
+    if ( DmDatabaseInfo( cardNo, dbID, NULL, NULL, &version, NULL, NULL, 
+                         NULL, NULL, NULL, NULL, NULL, NULL ) != errNone ) {
+        return;
+    }
+    if ( version >= gDBVersion ) {
+        return;
+    }
+
+    oldSize = 0;
+    if ( DmNumRecords( gDBRef ) > 0 ) {
+        oldHandle = DmQueryRecord( gDBRef, 0 );
+        oldSize = MemHandleSize( oldHandle );
+
+        /* Empty, or too big to have come from the post form */
+        if ( (oldSize == 0) || (oldSize > DRAFT_MAX_SIZE) ) {
+            DmRemoveRecord( gDBRef, 0 );
+            oldSize = 0;
+        }
+    }
+
+    if ( oldSize > 0 ) {
+        header.modified = TimGetSeconds();
+        header.created = header.modified;
+        StrCopy( header.blogID, gPrefs.blogID );
+        header.state = DS_UNSENT;
+        header.size = oldSize;
+
+        index = 1;
+        dbHandle = DmNewRecord( gDBRef, &index, 
+                                sizeof(DraftHeader) + oldSize );
+        if ( dbHandle == NULL ) {
+            return;
+        }
+        recText = MemHandleLock( dbHandle );
+        oldText = MemHandleLock( oldHandle );
+        DmWrite( recText, 0, &header, sizeof(DraftHeader) );
+        DmWrite( recText, sizeof(DraftHeader), oldText, oldSize );
+        MemHandleUnlock( oldHandle );
+        MemHandleUnlock( dbHandle );
+        DmReleaseRecord( gDBRef, index, true );
+
+        DmRemoveRecord( gDBRef, 0 );
+        DmRecordInfo( gDBRef, 0, NULL, &gDraftID, NULL );
+    }
+
+    version = gDBVersion;
+    DmSetDatabaseInfo( cardNo, dbID, NULL, NULL, &version, NULL, NULL, NULL, 
+                       NULL, NULL, NULL, NULL, NULL );
+}
+
+
+/*
+ */
+
+static Boolean FormHasCategory( void )
+{
+    switch ( FrmGetActiveFormID() ) {
+        case MinimalForm:
+            return( false );
+            break;
 
         case MainForm:
             return( true );
@@ -1844,6 +1960,62 @@ static Boolean FormHasTitle( void )
 }
 
 
+/*
+ */
+
+static Boolean FormHasTitle( void )
+{
+    switch ( FrmGetActiveFormID() ) {
+        case MinimalForm:
+            return( false );
+            break;
+
+        case MainForm:
+            return( true );
+            break;
+
+        default:
+            break;
+    }
+
+    return( false );
+}
+
+
+/*
+ * Name:   PostAPIForType()
+ * Args:   type - one of the BT_ blog types
+ * Return: how to make a post to that type of blog
+ * Desc:   Only Blogger itself doesn't speak the metaWeblog API.
+ */
+
+static const PostAPI gBloggerPost = {
+    "blogger.newPost", BloggerPostParams
+};
+
+static const PostAPI gMetaWeblogPost = {
+    "metaWeblog.newPost", MetaWeblogPostParams
+};
+
+static const PostAPI *PostAPIForType( int type )
+{
+    switch ( type ) {
+        case BT_JOURNALSPACE:
+        case BT_WORDPRESS:
+        case BT_MOVABLETYPE:
+        case BT_TYPEPAD:
+        case BT_B2:
+        case BT_LIVEJOURNAL:
+            return &gMetaWeblogPost;
+
+        default:
+            break;
+    }
+
+    return &gBloggerPost;
+}
+
+
 /*
  */
 
@@ -1921,7 +2093,6 @@ static Boolean MainFormHandler( EventType *event )
     Boolean handled = false;
     EventType updateEvt;
     FormType *frm;
-    MemHandle dbHandle;
     UInt16 frmId;
     FieldPtr field;
     UInt16 start;
@@ -1937,17 +2108,7 @@ static Boolean MainFormHandler( EventType *event )
         case frmOpenEvent:
             frm = FrmGetActiveForm();
 
-            if ( DmNumRecords( gDBRef ) > 0 ) {
-                dbHandle = DmQueryRecord( gDBRef, 0 );
-                if ( dbHandle != NULL ) {
-                    UnserializeDBRec( dbHandle );
-                /*
-                    recText = MemHandleLock( dbHandle );
-                    SetTextField( GetCurrFormObjPtr( BlogEntryFld ), recText );
-                    MemHandleUnlock( dbHandle );
-                */
-                }
-            }
+            LoadDraft();
 
             FrmDrawForm( frm );
 
@@ -2088,6 +2249,26 @@ static Boolean MainFormHandler( EventType *event )
                     handled = true;
                     break;
 
+                case NewDraftMItem:
+                    /*
+                     * Has to be saved before gDraftID changes, closing the
+                     * form would be too late.
+                     */
+                    if ( gDBRef != NULL ) {
+                        SerializeDBRec();
+                    }
+                    gDraftID = 0;
+                    FrmGotoForm( FormForType( gPrefs.blogType ) );
+                    handled = true;
+                    break;
+
+                case DraftsMItem:
+                    if ( gDBRef != NULL ) {
+                        FrmGotoForm( DraftListForm );
+                    }
+                    handled = true;
+                    break;
+
                 case BoldMItem:
                     AddMarkup( BlogEntryFld, "<b>", "<b>", "</b>" );
                     handled = true;
@@ -2287,106 +2468,46 @@ static Boolean AboutFormHandler( EventType *event )
     return handled;
 }
 
-#define VALUE_TAG "<value>"
-#define STRING_TAG "<string>"
-
-#define BLOG_ID_SRCH "<name>blogid</name>"
-#define BLOG_ID_SRCH_LEN (19)
-
-
-/*
- */
-
-static int ExtractBlogID( char *start, char *end, BlogEntry *entry )
-{
-    char *search;
-    char *skiped;
-    char *endSearch;
-    int copyOffset;
-
-    search = start;
-    endSearch = end - BLOG_ID_SRCH_LEN;
-    if ( endSearch < search ) {
-        return -1;
-    }
-
-    while ( search < endSearch ) {
-        if ( *search == '<' ) {
-            if ( StrNCompare( search, BLOG_ID_SRCH, BLOG_ID_SRCH_LEN ) == 0 ) {
-                search += BLOG_ID_SRCH_LEN;
-                search = StrStr( search, VALUE_TAG );
-                if ( search == NULL ) {
-                    return -1;
-                }
-                search += StrLen( VALUE_TAG );
-                skiped = SkipWhitespaceMatch( search, STRING_TAG );
-                if ( skiped != NULL ) {
-                    search = skiped;
-                }
-                copyOffset = 0;
-                while ( (*search != '<') && (search < end) && 
-                        (copyOffset < (BLOG_ID_LEN - 1)) ) {
-                    (entry->id)[copyOffset++] = *search++;
-                }
-                (entry->id)[copyOffset] = '\0';
-                return 0;
-            }
-        }
-        search++;
-    }
-
-    return -1;
-}
-
-
-#define BLOG_NAME_SRCH "<name>blogName</name>"
-#define BLOG_NAME_SRCH_LEN (21)
-
-
 /*
+ * Used while the blog list comes in.  Each struct in the getUsersBlogs
+ * response is one blog, and its members are told apart by name as they go
+ * by, so the response is only looked at once however many blogs there are.
+ * Servers don't agree on the case of the names (blogid, blogID, blogId),
+ * so the match ignores it.  Only the name and ID make it into the list,
+ * the URL and admin flag are kept while the blog's struct is open.
  */
 
-static int ExtractBlogName( char *start, char *end, BlogEntry *entry )
-{
-    char *search;
-    char *skiped;
-    char *endSearch;
-    int copyOffset;
-
-    search = start;
-    endSearch = end - BLOG_NAME_SRCH_LEN;
-    if ( endSearch < search ) {
-        return -1;
-    }
-
-    while ( search < endSearch ) {
-        if ( *search == '<' ) {
-            if ( StrNCompare( search, BLOG_NAME_SRCH,
-                              BLOG_NAME_SRCH_LEN ) == 0 ) {
-                search += BLOG_NAME_SRCH_LEN;
-                search = StrStr( search, VALUE_TAG );
-                if ( search == NULL ) {
-                    return -1;
-                }
-                search += StrLen( VALUE_TAG );
-                skiped = SkipWhitespaceMatch( search, STRING_TAG );
-                if ( skiped != NULL ) {
-                    search = skiped;
-                }
-                copyOffset = 0;
-                while ( (*search != '<') && (search < end) && 
-                        (copyOffset < (BLOG_NAME_LEN - 1)) ) {
-                    (entry->name)[copyOffset++] = *search++;
-                }
-                (entry->name)[copyOffset] = '\0';
-                return 0;
-            }
-        }
-        search++;
-    }
-    
-    return -1;
-}
+#define BM_OTHER (0)
+#define BM_BLOGID (1)
+#define BM_BLOGNAME (2)
+#define BM_URL (3)
+#define BM_ISADMIN (4)
+
+typedef struct BlogMember_struct {
+    const char *name;
+    UInt8 member;
+} BlogMember;
+
+static const BlogMember gBlogMembers[] = {
+    { "blogid", BM_BLOGID },
+    { "blogName", BM_BLOGNAME },
+    { "url", BM_URL },
+    { "isAdmin", BM_ISADMIN },
+    { NULL, BM_OTHER }
+};
+
+typedef struct BlogListLoad_struct {
+    BlogEntry *entries;
+    int count;
+    int allocLen;
+    Boolean failed;
+    UInt8 member;
+    UInt16 fill;
+    BlogEntry blog;
+    char url[URL_LEN];
+    Boolean isAdmin;
+    FieldPtr status;
+} BlogListLoad;
 
 
 /*
@@ -2415,181 +2536,238 @@ static int ResizeEntries( BlogEntry **entries, int count, int startCount )
 
 
 /*
+ * Name:   AppendValue()
+ * Args:   dest - string being filled in
+ *         size - size of 'dest'
+ *         fill - characters already in 'dest'
+ *         event - the value, or the next piece of it
+ * Return: none
+ * Desc:   Anything that doesn't fit is dropped.
  */
 
-static void PullBlogInfo( char *params, BlogEntry **entries, int *count )
+static void AppendValue( char *dest, UInt16 size, UInt16 *fill,
+                         XREvent *event )
 {
-    char *structStart;
-    char *structEnd;
-    int allocLen;
-    FormType *form;
-    FieldPtr field;
-    char statusString[50];
+    UInt16 room;
 
-    form = FrmGetActiveForm();
-    field = (FieldPtr)GetObjectPtr( form, BlogLoadStatus );
+    room = (size - 1) - *fill;
+    if ( event->length < room ) {
+        room = event->length;
+    }
 
-    allocLen = MAX_BLOGS;
-    *entries = (BlogEntry *)MemPtrNew( sizeof(BlogEntry) * allocLen );
-    if ( *entries == NULL ) {
-        *count = 0;
-        return;
+    MemMove( dest + *fill, event->text, room );
+    *fill += room;
+    dest[*fill] = '\0';
+}
+
+
+/*
+ * Name:   AddLoadedBlog()
+ * Args:   load - blog list being loaded
+ * Return: 0 on success, -1 if out of memory
+ * Desc:   Called as each blog's struct closes.  A blog without an ID is no
+ *         use to us and is left out, one without a name goes in under its
+ *         ID.
+ */
+
+static int AddLoadedBlog( BlogListLoad *load )
+{
+    char statusString[50];
+
+    if ( load->blog.id[0] == '\0' ) {
+        return 0;
     }
 
-    structEnd = params;
-    *count = 0;
+    if ( load->blog.name[0] == '\0' ) {
+        StrCopy( load->blog.name, load->blog.id );
+    }
 
-    while ( (structStart = StrStr( structEnd, "<struct>" )) != NULL ) {
-        if ( *count == allocLen ) {
-            if ( ResizeEntries( entries, allocLen + MAX_BLOGS, allocLen )
-                    != 0 ) {
-                MemPtrFree( *entries );
-                return;
-            }
-            allocLen += MAX_BLOGS;
+    if ( load->count == load->allocLen ) {
+        if ( ResizeEntries( &(load->entries), load->allocLen + MAX_BLOGS,
+                            load->allocLen ) != 0 ) {
+            return -1;
         }
+        load->allocLen += MAX_BLOGS;
+    }
 
-        structEnd = StrStr( structStart, "</struct>" );
-        if ( structEnd == NULL ) {
-            return;
-        }
-        if ( ExtractBlogID( structStart, structEnd,
-                            &((*entries)[*count]) ) != 0 ) {
-            return;
-        }
-        if ( ExtractBlogName( structStart, structEnd,
-                              &((*entries)[*count]) ) != 0 ) {
-            return;
-        }
-        *count += 1;
+    load->entries[load->count] = load->blog;
+    load->count += 1;
 
-        StrPrintF( statusString, "Found blog %d", *count );
-        SetTextField( field, statusString );
-        FldDrawField( field );
-    }
+    StrPrintF( statusString, "Found blog %d", load->count );
+    SetTextField( load->status, statusString );
+    FldDrawField( load->status );
+
+    return 0;
 }
 
 
 /*
+ * Name:   BlogListEvent()
+ * Args:   ctx - the BlogListLoad
+ *         event - next part of the getUsersBlogs response
+ * Return: true to stop reading the response
+ * Desc:   The response is an array of structs, so the blogs are at depth 1
+ *         and their members at depth 2.
  */
 
-static int ParseBlogInfo( char *response, FaultInfo *fault, 
-                          BlogEntry **entries, int *count )
+static Boolean BlogListEvent( void *ctx, XREvent *event )
 {
-    char *methodResponse;
-    char *afterResponse;
-    char *params;
-    char *faultTag;
+    BlogListLoad *load;
+    UInt8 i;
+
+    load = (BlogListLoad *)ctx;
+
+    switch ( event->kind ) {
+        case XRE_STRUCT_BEGIN:
+            if ( event->depth == 1 ) {
+                load->blog.name[0] = '\0';
+                load->blog.id[0] = '\0';
+                load->url[0] = '\0';
+                load->isAdmin = false;
+                load->member = BM_OTHER;
+            }
+            break;
 
-    if ( ParseXMLRPCDecl( response, &methodResponse ) != 0 ) {
-        fault->code = 0;
-        StrCopy( fault->string, "Unable to find XML declaration" );
-        return -1;
-    }
+        case XRE_STRUCT_END:
+            if ( event->depth == 1 ) {
+                if ( AddLoadedBlog( load ) != 0 ) {
+                    load->failed = true;
+                    return true;
+                }
+            }
+            break;
 
-    afterResponse = SkipWhitespaceMatch( methodResponse, "<methodResponse>" );
-    if ( afterResponse == NULL ) {
-        fault->code = 0;
-        StrCopy( fault->string, "Missing method response tag" );
-        return -1;
-    }
+        case XRE_MEMBER:
+            if ( event->depth == 2 ) {
+                for ( i = 0; gBlogMembers[i].name != NULL; i++ ) {
+                    if ( StrCaselessCompare( event->text,
+                                             gBlogMembers[i].name ) == 0 ) {
+                        break;
+                    }
+                }
+                load->member = gBlogMembers[i].member;
+                load->fill = 0;
+            }
+            break;
 
-    params = SkipWhitespaceMatch( afterResponse, "<params>" );
-    if ( params != NULL ) {
-        PullBlogInfo( params, entries, count );
-        return 0;
-    }
+        case XRE_VALUE:
+            if ( event->depth != 2 ) {
+                break;
+            }
+            switch ( load->member ) {
+                case BM_BLOGID:
+                    AppendValue( load->blog.id, BLOG_ID_LEN, &(load->fill),
+                                 event );
+                    break;
 
-    faultTag = SkipWhitespaceMatch( afterResponse, "<fault>" );
-    if ( faultTag != NULL ) {
-        ParseFaultInfo( faultTag, fault );
-        return -1;
-    }
+                case BM_BLOGNAME:
+                    AppendValue( load->blog.name, BLOG_NAME_LEN,
+                                 &(load->fill), event );
+                    break;
 
-    fault->code = 0;
-    StrCopy( fault->string, "Unexpected tag after method response" );
+                case BM_URL:
+                    AppendValue( load->url, URL_LEN, &(load->fill), event );
+                    break;
 
-    return -1;
+                case BM_ISADMIN:
+                    load->isAdmin = (StrAToI( event->text ) != 0) ||
+                                    (StrCaselessCompare( event->text,
+                                                         "true" ) == 0);
+                    break;
+
+                default:
+                    break;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return false;
 }
 
 
 /*
+ * Name:   LoadUserBlogs()
+ * Args:   entries - set to the blogs found, to be freed by the caller
+ *         count - set to the number of blogs found
+ * Return: 0 on success, -1 on failure (the user has been told why)
+ * Desc:   The response is parsed as it comes in, so it's never held in
+ *         memory, and each blog is added to the list as its struct closes.
  */
 
 static int LoadUserBlogs( BlogEntry **entries, int *count )
 {
-    char *request;
     URLTarget target;
     int retValue;
-    FaultInfo fault;
+    Int16 postres;
     FormType *form;
-    FieldPtr field;
-    char *escapedName;
-    char *escapedPass;
+    XRBuild build;
+    HTTPBody body;
+    XRParser parser;
+    XRResult fault;
+    BlogListLoad load;
 
     form = FrmGetActiveForm();
-    field = (FieldPtr)GetObjectPtr( form, BlogLoadStatus );
+    load.status = (FieldPtr)GetObjectPtr( form, BlogLoadStatus );
 
-    SetTextField( field, "Formatting request" );
-    FldDrawField( field );
+    SetTextField( load.status, "Formatting request" );
+    FldDrawField( load.status );
 
-    escapedName = EscapeString( gPrefs.name );
-    if ( escapedName == NULL ) {
+    load.allocLen = MAX_BLOGS;
+    load.entries = (BlogEntry *)MemPtrNew( sizeof(BlogEntry) * 
+                                           load.allocLen );
+    if ( load.entries == NULL ) {
         FrmCustomAlert( BlogLoadErrAlert,
                         "Out of memory trying to form request", NULL, NULL );
         return -1;
     }
+    load.count = 0;
+    load.failed = false;
+    load.member = BM_OTHER;
 
-    escapedPass = EscapeString( gPrefs.pass );
-    if ( escapedPass == NULL ) {
-        FrmCustomAlert( BlogLoadErrAlert,
-                        "Out of memory trying to form request", NULL, NULL );
-        MemPtrFree( escapedName );
-        return -1;
-    }
-
-    request = (char *)MemPtrNew( INFOREQ_SIZE );
-    if ( request == NULL ) {
-        FrmCustomAlert( BlogLoadErrAlert,
-                        "Out of memory trying to form request", NULL, NULL );
-        MemPtrFree( escapedName );
-        MemPtrFree( escapedPass );
-        return -1;
-    }
-
-    StrPrintF( request, gUsersBlogsReq, escapedName, escapedPass );
-
-    MemPtrFree( escapedName );
-    MemPtrFree( escapedPass );
+    build.build = UsersBlogsBuild;
+    build.ctx = NULL;
+    XRBuildBody( &build, &body );
 
     target.host = gPrefs.host;
     target.port = StrAToI( gPrefs.port );
     target.path = gPrefs.url;
 
-    SetTextField( field, "Transmitting" );
-    FldDrawField( field );
+    SetTextField( load.status, "Transmitting" );
+    FldDrawField( load.status );
 
     retValue = -1;
-    if ( HTTPPost( &target, request, (char *)gTempDBName ) == HTTPErr_OK ) {
-        SetTextField( field, "Processing Response" );
-        FldDrawField( field );
-        if ( ReadWholeFile( gTempDBName, request, INFOREQ_SIZE ) ) {
-            if ( ParseBlogInfo( request, &fault, entries, count ) == 0 ) {
-                retValue = 0;
-            } else {
-                FrmCustomAlert( BlogLoadErrAlert, fault.string, NULL, NULL );
-            }
-
-        } else {
-            FrmCustomAlert( BlogLoadErrAlert, 
-                            "Out of memory processing response", NULL, NULL );
-        }
-    } else {
+    XRParserStart( &parser, BlogListEvent, &load, &fault );
+    postres = HTTPPostBody( &target, &body, NULL, XRParserWatch,
+                            &parser );
+#if defined(HTTP_NETSIM)
+    NetSimReport();
+#endif
+
+    if ( postres != HTTPErr_OK ) {
         FrmCustomAlert( BlogLoadErrAlert, "Unable to contact server", NULL,
                         NULL );
+    } else if ( load.failed ) {
+        FrmCustomAlert( BlogLoadErrAlert, 
+                        "Out of memory processing response", NULL, NULL );
+    } else if ( fault.fault ) {
+        FrmCustomAlert( BlogLoadErrAlert, fault.text, NULL, NULL );
+    } else if ( XRParserEnd( &parser ) != 0 ) {
+        FrmCustomAlert( BlogLoadErrAlert, "Unexpected response from server",
+                        NULL, NULL );
+    } else {
+        retValue = 0;
+    }
+
+    if ( retValue != 0 ) {
+        MemPtrFree( load.entries );
+        return retValue;
     }
 
-    MemPtrFree( request );
+    *entries = load.entries;
+    *count = load.count;
 
     return retValue;
 }
@@ -2612,6 +2790,7 @@ static int RefreshBlogListEntries( void )
     }
 
     if ( count == 0 ) {
+        MemPtrFree( entries );
         return -1;
     }
 
@@ -2761,6 +2940,97 @@ static int LoadBlogsFromPrefs( void )
 }
 
 
+/*
+ * Name:   TreeBlog()
+ * Args:   tree - tree holding a getUsersBlogs response
+ *         ref - one blog's struct
+ *         blog - filled in with the blog's name and ID
+ * Return: true if the blog is worth keeping
+ * Desc:   Same rules as AddLoadedBlog(), a blog needs an ID and goes in
+ *         under it if it has no name.
+ */
+
+static Boolean TreeBlog( XRTree *tree, XRNodeRef ref, BlogEntry *blog )
+{
+    const char *text;
+
+    text = XRTreeText( tree, XRTreeMember( tree, ref, "blogid" ) );
+    StrNCopy( blog->id, text, BLOG_ID_LEN - 1 );
+    blog->id[BLOG_ID_LEN - 1] = '\0';
+    if ( blog->id[0] == '\0' ) {
+        return false;
+    }
+
+    text = XRTreeText( tree, XRTreeMember( tree, ref, "blogName" ) );
+    StrNCopy( blog->name, text, BLOG_NAME_LEN - 1 );
+    blog->name[BLOG_NAME_LEN - 1] = '\0';
+    if ( blog->name[0] == '\0' ) {
+        StrCopy( blog->name, blog->id );
+    }
+
+    return true;
+}
+
+
+/*
+ * Name:   SaveBlogsFromTree()
+ * Args:   tree - tree holding a getUsersBlogs response
+ *         list - the response's array of blogs
+ * Return: none
+ * Desc:   Replaces the saved blog list.  One with no usable blogs in it
+ *         leaves the old list alone, as a reload from the blog list form
+ *         would.
+ */
+
+static void SaveBlogsFromTree( XRTree *tree, XRNodeRef list )
+{
+    BlogEntry blog;
+    XRNodeRef ref;
+    int numRecs;
+    int count;
+    int i;
+    UInt16 index;
+    MemHandle dbHandle;
+    void *rec;
+
+    count = 0;
+    for ( ref = XRTreeFirst( tree, list ); ref != XR_NO_NODE;
+            ref = XRTreeNext( tree, ref ) ) {
+        if ( TreeBlog( tree, ref, &blog ) ) {
+            count++;
+        }
+    }
+    if ( count == 0 ) {
+        return;
+    }
+
+    numRecs = DmNumRecords( gPrefDBRef );
+    for ( i = 0; i < numRecs; i++) {
+        DmRemoveRecord( gPrefDBRef, 0 );
+    }
+
+    for ( ref = XRTreeFirst( tree, list ); ref != XR_NO_NODE;
+            ref = XRTreeNext( tree, ref ) ) {
+        if ( !TreeBlog( tree, ref, &blog ) ) {
+            continue;
+        }
+
+        index = dmMaxRecordIndex;
+        dbHandle = DmNewRecord( gPrefDBRef, &index, sizeof(BlogEntry) );
+        if ( dbHandle == NULL ) {
+            return;
+        }
+
+        rec = MemHandleLock( dbHandle );
+        DmStrCopy( rec, 0, blog.name );
+        DmStrCopy( rec, BLOG_NAME_LEN, blog.id );
+
+        MemHandleUnlock( dbHandle );
+        DmReleaseRecord( gPrefDBRef, index, false );
+    }
+}
+
+
 /*
  */
 
@@ -2969,6 +3239,254 @@ static Boolean BlogListFormHandler( EventType *event )
 }
 
 
+/*
+ * Name:   DraftFieldLength()
+ * Args:   field - start of a '\0' terminated field in a draft record
+ *         limit - bytes left in the record from 'field' on
+ * Return: length of the field, -1 if it isn't terminated inside the record
+ * Desc:   StrLen() that never looks past the end of the record.
+ */
+
+static Int32 DraftFieldLength( const char *field, UInt32 limit )
+{
+    UInt32 length;
+
+    for ( length = 0; length < limit; length++ ) {
+        if ( field[length] == '\0' ) {
+            return length;
+        }
+    }
+
+    return -1;
+}
+
+
+/*
+ * Name:   DraftListDraw()
+ * Args:   itemNum - index of the draft's record
+ *         bounds - where to draw it
+ *         itemsText - unused, the list has no strings of its own
+ * Return: none
+ * Desc:   The list draws each row as it's shown, straight from the record,
+ *         so opening it doesn't depend on how many drafts there are.  A
+ *         row is the title, or the start of the post if there isn't one,
+ *         with the date it was last changed.
+ */
+
+static void DraftListDraw( Int16 itemNum, RectangleType *bounds,
+                           Char **itemsText )
+{
+    MemHandle dbHandle;
+    char *record;
+    DraftHeader *header;
+    char *fields[3];
+    char *text;
+    char date[dateStringLength];
+    DateType when;
+    Int16 dateWidth;
+    Int16 x;
+    Int16 length;
+    Int32 fieldLength;
+    UInt32 offset;
+    UInt32 size;
+    UInt16 field;
+    Boolean damaged;
+
+    dbHandle = DmQueryRecord( gDBRef, itemNum );
+    if ( dbHandle == NULL ) {
+        return;
+    }
+    record = MemHandleLock( dbHandle );
+    header = (DraftHeader *)record;
+
+    /*
+     * Each of the title, category and post has to end inside the record
+     * before anything is drawn from it.  The row is the title, or the post
+     * if the title's empty.  A draft that's damaged still gets a row, so
+     * it can be deleted.
+     */
+    size = MemHandleSize( dbHandle );
+    damaged = (size < sizeof(DraftHeader)) ||
+              (size != sizeof(DraftHeader) + header->size);
+    offset = sizeof(DraftHeader);
+    for ( field = 0; (field < 3) && !damaged; field++ ) {
+        fieldLength = DraftFieldLength( record + offset, size - offset );
+        if ( fieldLength < 0 ) {
+            damaged = true;
+        } else {
+            fields[field] = record + offset;
+            offset += fieldLength + 1;
+        }
+    }
+    if ( damaged ) {
+        WinDrawChars( gDamagedDraft, StrLen( gDamagedDraft ),
+                      bounds->topLeft.x, bounds->topLeft.y );
+        MemHandleUnlock( dbHandle );
+        return;
+    }
+
+    DateSecondsToDate( header->modified, &when );
+    DateToAscii( when.month, when.day, when.year + firstYear,
+                 (DateFormatType)PrefGetPreference( prefDateFormat ), date );
+    dateWidth = FntCharsWidth( date, StrLen( date ) );
+    WinDrawChars( date, StrLen( date ), 
+                  bounds->topLeft.x + bounds->extent.x - dateWidth,
+                  bounds->topLeft.y );
+
+    x = bounds->topLeft.x;
+    if ( header->state == DS_POSTED ) {
+        WinDrawChars( "*", 1, x, bounds->topLeft.y );
+        x += FntCharsWidth( "* ", 2 );
+    }
+
+    text = (*fields[0] != '\0') ? fields[0] : fields[2];
+    length = 0;
+    while ( (text[length] != '\0') && (text[length] != '\n') ) {
+        length++;
+    }
+    WinDrawTruncChars( text, length, x, bounds->topLeft.y,
+                       (bounds->topLeft.x + bounds->extent.x - dateWidth - 4) 
+                       - x );
+
+    MemHandleUnlock( dbHandle );
+}
+
+
+/*
+ */
+
+static Boolean DraftListFormHandler( EventType *event )
+{
+    Boolean handled = false;
+    FormType *frm;
+    ListPtr list;
+    Int16 selected;
+    UInt16 index;
+    UInt32 id;
+    EventType actionEvent;
+
+    switch ( event->eType ) {
+
+        case frmOpenEvent:
+            frm = FrmGetActiveForm();
+
+            list = (ListPtr)GetObjectPtr( frm, DraftList );
+            LstSetDrawFunction( list, DraftListDraw );
+            LstSetListChoices( list, NULL, DmNumRecords( gDBRef ) );
+            if ( FindDraft( gDraftID, &index ) ) {
+                LstSetSelection( list, index );
+                LstMakeItemVisible( list, index );
+            } else {
+                LstSetSelection( list, noListSelection );
+            }
+
+            FrmDrawForm( frm );
+            handled = true;
+            break;
+
+        case frmUpdateEvent:
+            FrmDrawForm( FrmGetActiveForm() );
+            handled = true;
+            break;
+
+        case ctlSelectEvent:
+            switch ( event->data.ctlSelect.controlID ) {
+                case DraftOpenBtn:
+                    frm = FrmGetActiveForm();
+                    list = (ListPtr)GetObjectPtr( frm, DraftList );
+                    selected = LstGetSelection( list );
+                    if ( selected != noListSelection ) {
+                        DmRecordInfo( gDBRef, selected, NULL, &gDraftID, 
+                                      NULL );
+                    }
+                    FrmGotoForm( FormForType( gPrefs.blogType ) );
+                    handled = true;
+                    break;
+
+                case DraftNewBtn:
+                    gDraftID = 0;
+                    FrmGotoForm( FormForType( gPrefs.blogType ) );
+                    handled = true;
+                    break;
+
+                case DraftDeleteBtn:
+                    frm = FrmGetActiveForm();
+                    list = (ListPtr)GetObjectPtr( frm, DraftList );
+                    selected = LstGetSelection( list );
+                    if ( (selected == noListSelection) || 
+                            (FrmAlert( DeleteDraftAlert ) != 0) ) {
+                        handled = true;
+                        break;
+                    }
+
+                    DmRecordInfo( gDBRef, selected, NULL, &id, NULL );
+                    RemoveDraft( id );
+                    if ( id == gDraftID ) {
+                        gDraftID = 0;
+                    }
+
+                    LstSetListChoices( list, NULL, DmNumRecords( gDBRef ) );
+                    LstSetSelection( list, noListSelection );
+                    LstEraseList( list );
+                    LstDrawList( list );
+                    handled = true;
+                    break;
+
+                case DraftCancelBtn:
+                    FrmGotoForm( FormForType( gPrefs.blogType ) );
+                    handled = true;
+                    break;
+
+                default:
+                    break;
+            }
+            break;
+
+        case menuEvent:
+            MemSet( &actionEvent, sizeof(EventType), 0);
+            actionEvent.eType = ctlSelectEvent;
+            switch ( event->data.menu.itemID ) {
+                case DraftOpenMItem:
+                    actionEvent.data.ctlSelect.controlID = DraftOpenBtn;
+                    EvtAddEventToQueue( &actionEvent );
+                    handled = true;
+                    break;
+
+                case DraftNewMItem:
+                    actionEvent.data.ctlSelect.controlID = DraftNewBtn;
+                    EvtAddEventToQueue( &actionEvent );
+                    handled = true;
+                    break;
+
+                case DraftDeleteMItem:
+                    actionEvent.data.ctlSelect.controlID = DraftDeleteBtn;
+                    EvtAddEventToQueue( &actionEvent );
+                    handled = true;
+                    break;
+
+                case DraftCancelMItem:
+                    actionEvent.data.ctlSelect.controlID = DraftCancelBtn;
+                    EvtAddEventToQueue( &actionEvent );
+                    handled = true;
+                    break;
+
+                default:
+                    break;
+            }
+            break;
+
+        case nilEvent:
+            handled = true;
+            break;
+
+        default:
+            break;
+    }
+
+    return handled;
+}
+
+
 /*
  */
 
@@ -3004,6 +3522,8 @@ static void SaveIdentityInfo( void )
         gPrefs.blogID[BLOG_ID_LEN-1] = '\0';
         MemHandleUnlock( fieldHandle );
     }
+
+    CredentialsChanged();
 }
 
 
@@ -3523,6 +4043,7 @@ static Boolean ServerFormHandler( EventType *event )
                     list = GetCurrFormObjPtr( ServerTypeList );
 
                     gPrefs.blogType = LstGetSelection( list );
+                    gMulticall = XR_MULTICALL_UNKNOWN;
 
                     FrmReturnToForm( FormForType( gSvrFormSaved ) );
 
@@ -3712,6 +4233,10 @@ static Boolean ApplicationHandleEvent( EventType *event )
                     FrmSetEventHandler( frm, BlogLoadFormHandler );
                     break;
 
+                case DraftListForm:
+                    FrmSetEventHandler( frm, DraftListFormHandler );
+                    break;
+
                 case AboutForm:
                     FrmSetEventHandler( frm, AboutFormHandler );
                     break;
@@ -0,0 +1,3011 @@
+/* arch-tag: XML-RPC request encoding for vagablog
+ *
+ * Vagablog - Palm based Blog utility
+ *
+ * Copyright (C) 2003,2004,2005 Mike Rowehl <miker@bitsplitter.net>
+ *
+ * Builds XML-RPC method calls.  Requests are streamed into the HTTP send
+ * window a piece at a time, so the size of a post has no effect on how much
+ * memory it takes to send it.
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#include <PalmOS.h>
+
+#include "http.h"
+#include "xmlrpc.h"
+
+
+/*
+ * Escaping is driven by gEscapeClass, indexed by character.  Class 0 is sent
+ * as is, 1 to 5 are the XML special characters and 7 is the terminator.
+ * Requests are sent as UTF-8, so the Palm characters above 7 bit ASCII are
+ * transcoded to 2 (class 8) or 3 (class 9) byte sequences.  The few with no
+ * Unicode equivalent, and DEL, are class 6 and go out as numeric character
+ * references like they always used to.  gClassLen is how many bytes each
+ * class takes on the wire and gClassText the replacement for the fixed ones.
+ */
+
+#define EC_SAFE (0)
+#define EC_NUMERIC (6)
+#define EC_END (7)
+#define EC_UTF8_2 (8)
+#define EC_UTF8_3 (9)
+
+static const UInt8 gEscapeClass[256] = {
+    7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x00 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x10 */
+    0, 0, 5, 0, 0, 0, 1, 2, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x20 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 4, 0,  /* 0x30 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x40 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x50 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x60 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6,  /* 0x70 */
+    9, 6, 9, 8, 9, 9, 9, 9, 8, 9, 8, 9, 8, 9, 9, 9,  /* 0x80 */
+    9, 9, 9, 9, 9, 9, 9, 9, 8, 9, 8, 9, 8, 6, 8, 8,  /* 0x90 */
+    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,  /* 0xA0 */
+    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,  /* 0xB0 */
+    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,  /* 0xC0 */
+    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,  /* 0xD0 */
+    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,  /* 0xE0 */
+    8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8   /* 0xF0 */
+};
+
+static const UInt8 gClassLen[] = { 1, 5, 6, 4, 4, 6, 6, 0, 2, 3 };
+
+static const char *gClassText[] = {
+    NULL, "&amp;", "&apos;", "&lt;", "&gt;", "&quot;", NULL, NULL, NULL, NULL
+};
+
+
+/*
+ * Unicode values for Palm characters 0x80 to 0x9F.  This range is the same
+ * as Windows code page 1252 apart from the card suits at 0x8D to 0x90.  The
+ * zero entries are unassigned (class 6 above).  0xA0 and up are the same as
+ * ISO-8859-1, so the character is its own Unicode value.
+ */
+
+static const UInt16 gPalmHighToUnicode[32] = {
+    0x20AC, 0x0000, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x2666, 0x2663, 0x2665,
+    0x2660, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x0000, 0x017E, 0x0178
+};
+
+
+/*
+ * Most text is long runs of characters that don't need escaping, so those
+ * are skipped four bytes at a time.  HAS_ZERO() is non-zero if any byte of
+ * the word is 0.  A word is all safe if none of its bytes are the
+ * terminator, '"', '&' or '\'' (which only differ in the low bit), '<' or
+ * '>' (which only differ in bit 1), DEL, or have the high bit set.
+ */
+
+#define WORD_ONES ((UInt32)0x01010101)
+#define WORD_HIGHS ((UInt32)0x80808080)
+#define HAS_ZERO( w ) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+#define WORD_SAFE( w ) \
+    (!(HAS_ZERO( w ) | \
+       HAS_ZERO( (w) ^ (UInt32)0x22222222 ) | \
+       HAS_ZERO( ((w) ^ (UInt32)0x26262626) & (UInt32)0xFEFEFEFE ) | \
+       HAS_ZERO( ((w) ^ (UInt32)0x3C3C3C3C) & (UInt32)0xFDFDFDFD ) | \
+       HAS_ZERO( (w) ^ (UInt32)0x7F7F7F7F ) | \
+       ((w) & WORD_HIGHS)))
+
+/*
+ * Private functions
+ */
+
+static const char *SafeRun( const char *text );
+static UInt16 EntityText( UInt8 cls, unsigned char ch, char *entity );
+static void EscapedText( XRBuilder *builder, const char *text );
+
+/* Request building */
+static void ValueBegin( XRBuilder *builder );
+static void ValueEnd( XRBuilder *builder );
+static void Scalar( XRBuilder *builder, const char *open, UInt16 openLen,
+                    const char *text, Boolean escape, const char *close,
+                    UInt16 closeLen );
+static void Nest( XRBuilder *builder, Boolean isStruct );
+static void Unnest( XRBuilder *builder );
+static void PutDigits( char *out, UInt16 value, UInt16 count );
+static void BuildWrite( void *ctx, HTTPWindow *window );
+
+/* Batched calls */
+static void ParamBuild( XRBuilder *builder, const XRParam *param );
+static void ParamsBuild( XRBuilder *builder, const XRCall *call );
+static void CallBuild( XRBuilder *builder, void *ctx );
+static void MulticallBuild( XRBuilder *builder, void *ctx );
+static int PostAndParse( URLTarget *url, HTTPBody *body, XRTree *tree,
+                         XRResult *fault );
+static int ProbeMulticall( URLTarget *url, XRBatch *batch, XRArena *arena );
+static void FaultText( XRResult *result );
+static void ScalarResult( XRTree *tree, XRNodeRef value, XRResult *result );
+static void FaultResult( XRTree *tree, XRNodeRef value, XRResult *result );
+static int MulticallResults( XRTree *tree, XRBatch *batch );
+
+/* Response parsing */
+static UInt8 ElementFor( const char *tag );
+static void Event( XRParser *parser, UInt8 kind, Boolean partial );
+static void FaultEvent( XRParser *parser, XREvent *event );
+static void KeepChar( XRParser *parser, char ch );
+static char PalmChar( UInt32 code );
+static void FlushDecode( XRParser *parser );
+static void DecodeByte( XRParser *parser, char ch );
+static void EndEntity( XRParser *parser );
+static void AddText( XRParser *parser, char ch );
+static void StartElement( XRParser *parser, UInt8 element );
+static void EndElement( XRParser *parser, UInt8 element );
+static void TagDone( XRParser *parser );
+static void KeepRun( XRParser *parser, const char *run, UInt32 length );
+static const char *SkipAhead( XRParser *parser, const char *data,
+                              const char *end );
+
+/* Response trees */
+static UInt16 TreeAlloc( XRTree *tree, UInt32 size );
+static UInt16 *TreeSlots( XRTree *tree, XRHash *hash );
+static UInt16 NameKey( const char *name, UInt16 length );
+static UInt16 MemberKey( XRNodeRef parent, UInt16 name );
+static int HashStart( XRTree *tree, XRHash *hash, UInt16 size );
+static int HashPut( XRTree *tree, XRHash *hash, UInt16 key, UInt16 entry );
+static UInt16 FindName( XRTree *tree, const char *name, UInt16 length );
+static UInt16 InternName( XRTree *tree, const char *name, UInt16 length );
+static XRNodeRef AddNode( XRTree *tree, UInt8 depth, UInt8 type );
+static int TreeText( XRTree *tree, XREvent *event );
+static void EndText( XRTree *tree );
+
+/* Media uploads */
+static UInt32 SourceRead( XRSource *source, UInt8 *buffer, UInt32 length );
+static void MediaBuild( XRBuilder *builder, void *ctx );
+
+
+/*
+ * Name:   SafeRun()
+ * Args:   text - where to start looking
+ * Return: pointer to the first character at or after 'text' that needs
+ *         escaping, or to the terminator
+ * Desc:   Steps a byte at a time up to a 4 byte boundary (the 68000 can't
+ *         read a long from an odd address), then a word at a time till a
+ *         word holds something interesting, then finds which byte it was.
+ *         Reading the rest of the word past the terminator is harmless.
+ */
+
+static const char *SafeRun( const char *text )
+{
+    const UInt32 *word;
+
+    while ( (((unsigned long)text) & 3) != 0 ) {
+        if ( gEscapeClass[(UInt8)*text] != EC_SAFE ) {
+            return text;
+        }
+        text++;
+    }
+
+    word = (const UInt32 *)text;
+    while ( WORD_SAFE( *word ) ) {
+        word++;
+    }
+
+    text = (const char *)word;
+    while ( gEscapeClass[(UInt8)*text] == EC_SAFE ) {
+        text++;
+    }
+
+    return text;
+}
+
+
+/*
+ * Name:   EntityText()
+ * Args:   cls - escape class of 'ch'
+ *         ch - the character being escaped
+ *         entity - buffer of at least XR_ESCAPE_MAX chars to get the
+ *                  replacement text (not terminated)
+ * Return: length of the replacement
+ * Desc:   Fills in the wire form of a character that can't go out as is,
+ *         either an entity or a UTF-8 sequence.
+ */
+
+static UInt16 EntityText( UInt8 cls, unsigned char ch, char *entity )
+{
+    UInt16 code;
+
+    if ( (cls == EC_UTF8_2) || (cls == EC_UTF8_3) ) {
+        if ( ch < 0xA0 ) {
+            code = gPalmHighToUnicode[ch - 0x80];
+        } else {
+            code = ch;
+        }
+
+        if ( cls == EC_UTF8_2 ) {
+            entity[0] = 0xC0 | (code >> 6);
+            entity[1] = 0x80 | (code & 0x3F);
+        } else {
+            entity[0] = 0xE0 | (code >> 12);
+            entity[1] = 0x80 | ((code >> 6) & 0x3F);
+            entity[2] = 0x80 | (code & 0x3F);
+        }
+    } else if ( cls == EC_NUMERIC ) {
+        entity[0] = '&';
+        entity[1] = '#';
+        entity[2] = '0' + (ch / 100);
+        entity[3] = '0' + ((ch / 10) % 10);
+        entity[4] = '0' + (ch % 10);
+        entity[5] = ';';
+    } else {
+        MemMove( entity, gClassText[cls], gClassLen[cls] );
+    }
+
+    return gClassLen[cls];
+}
+
+
+/*
+ * Name:   XREscapeBounded()
+ * Args:   text - text to apply escaping to
+ *         out - buffer for the escaped text
+ *         outSize - size of 'out', including room for the terminator
+ * Return: length of the escaped text, or -1 if it didn't fit
+ * Desc:   Escapes in a single pass with no sizing run first.  Callers that
+ *         know how long the input can be can size 'out' with
+ *         XR_ESCAPED_SIZE() and never see -1.  On failure 'out' holds as
+ *         much as fit, up to the last whole character.
+ */
+
+Int32 XREscapeBounded( const char *text, char *out, UInt32 outSize )
+{
+    const char *run;
+    UInt32 used;
+    UInt32 count;
+    UInt8 cls;
+
+    if ( outSize == 0 ) {
+        return -1;
+    }
+
+    used = 0;
+    for ( ;; ) {
+        run = SafeRun( text );
+        count = run - text;
+        cls = gEscapeClass[(UInt8)*run];
+
+        if ( (used + count + gClassLen[cls]) >= outSize ) {
+            out[used] = '\0';
+            return -1;
+        }
+
+        MemMove( out + used, text, count );
+        used += count;
+        if ( cls == EC_END ) {
+            break;
+        }
+        used += EntityText( cls, (unsigned char)*run, out + used );
+        text = run + 1;
+    }
+
+    out[used] = '\0';
+    return used;
+}
+
+
+/*
+ * Layout of the call around the values.  Servers don't care about it, so by
+ * default requests go out with no whitespace between elements.  Building
+ * with XMLRPC_PRETTY defined puts each param on its own line, which is
+ * easier to read in a packet trace.
+ */
+
+#if defined(XMLRPC_PRETTY)
+#define XR_NL "\n"
+#define XR_INDENT1 "  "
+#define XR_INDENT2 "    "
+#define XR_INDENT3 "      "
+#else
+#define XR_NL ""
+#define XR_INDENT1 ""
+#define XR_INDENT2 ""
+#define XR_INDENT3 ""
+#endif
+
+#define XR_CALL_START \
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" XR_NL \
+    "<methodCall>" XR_NL \
+    XR_INDENT1 "<methodName>"
+
+#define XR_CALL_PARAMS \
+    "</methodName>" XR_NL \
+    XR_INDENT1 "<params>" XR_NL
+
+#define XR_CALL_CLOSE \
+    XR_INDENT1 "</params>" XR_NL \
+    "</methodCall>" XR_NL
+
+#define XR_PARAM_OPEN XR_INDENT2 "<param>" XR_NL XR_INDENT3 "<value>"
+#define XR_PARAM_CLOSE "</value>" XR_NL XR_INDENT2 "</param>" XR_NL
+
+#define LITERAL( literal ) literal, (sizeof( literal ) - 1)
+
+#define DATETIME_LEN (17)
+
+
+/*
+ * Name:   XRBuilderCount(), XRBuilderWindow(), XRBuilderBuffer()
+ * Args:   builder - builder to set up
+ *         window - send window to write into
+ *         buffer - memory to write into
+ *         size - size of 'buffer', including room for the terminator
+ * Return: none
+ * Desc:   Start a builder that only counts, one that sends, and one that
+ *         writes into memory.
+ */
+
+void XRBuilderCount( XRBuilder *builder )
+{
+    MemSet( builder, sizeof( XRBuilder ), 0 );
+    builder->sink = XRB_COUNT;
+}
+
+void XRBuilderWindow( XRBuilder *builder, HTTPWindow *window )
+{
+    XRBuilderCount( builder );
+    builder->sink = XRB_WINDOW;
+    builder->window = window;
+}
+
+void XRBuilderBuffer( XRBuilder *builder, char *buffer, UInt32 size )
+{
+    XRBuilderCount( builder );
+    builder->sink = XRB_BUFFER;
+    builder->buffer = buffer;
+    builder->size = size;
+}
+
+
+/*
+ * Name:   XRBuilderEnd()
+ * Args:   builder - builder that's finished with
+ * Return: number of bytes built, or -1 if they didn't all fit in the
+ *         builder's buffer
+ * Desc:   Terminates the text in a buffer builder.  The length is the
+ *         whole request even when it didn't fit, so it can be used to
+ *         size a buffer for another try.
+ */
+
+Int32 XRBuilderEnd( XRBuilder *builder )
+{
+    if ( builder->sink == XRB_BUFFER ) {
+        if ( builder->length >= builder->size ) {
+            if ( builder->size > 0 ) {
+                builder->buffer[builder->size - 1] = '\0';
+            }
+            return -1;
+        }
+        builder->buffer[builder->length] = '\0';
+    }
+
+    return builder->length;
+}
+
+
+/*
+ * Name:   XRRaw()
+ * Args:   builder - where to write
+ *         text - bytes to write as is
+ *         length - number of bytes
+ * Return: none
+ * Desc:   Everything a builder produces comes through here.  A buffer
+ *         builder keeps counting once it's full, so the length still comes
+ *         out right.
+ */
+
+void XRRaw( XRBuilder *builder, const char *text, UInt32 length )
+{
+    UInt32 room;
+
+    if ( builder->sink == XRB_WINDOW ) {
+        HTTPWindowWrite( builder->window, text, length );
+    } else if ( (builder->sink == XRB_BUFFER) && 
+                (builder->length < builder->size) ) {
+        room = builder->size - builder->length;
+        if ( room > length ) {
+            room = length;
+        }
+        MemMove( builder->buffer + builder->length, text, room );
+    }
+
+    builder->length += length;
+}
+
+
+/*
+ * Name:   EscapedText()
+ * Args:   builder - where to write
+ *         text - text to escape
+ * Return: none
+ * Desc:   The one escaping loop, for every kind of builder, so the length
+ *         counted for a request can't disagree with what's sent.  Runs of
+ *         characters that don't need escaping go out straight from 'text',
+ *         nothing is copied except the entities themselves.  A counting
+ *         builder takes the entity lengths from the table rather than
+ *         building them.
+ */
+
+static void EscapedText( XRBuilder *builder, const char *text )
+{
+    const char *run;
+    char entity[XR_ESCAPE_MAX];
+    UInt8 cls;
+
+    for ( ;; ) {
+        run = SafeRun( text );
+        if ( run > text ) {
+            XRRaw( builder, text, run - text );
+        }
+
+        cls = gEscapeClass[(UInt8)*run];
+        if ( cls == EC_END ) {
+            break;
+        }
+        if ( builder->sink == XRB_COUNT ) {
+            builder->length += gClassLen[cls];
+        } else {
+            XRRaw( builder, entity, 
+                   EntityText( cls, (unsigned char)*run, entity ) );
+        }
+        text = run + 1;
+    }
+}
+
+
+/*
+ * Name:   XRText()
+ * Args:   builder - where to write
+ *         text - text to write
+ *         escape - true if 'text' needs XML escaping
+ * Return: none
+ */
+
+void XRText( XRBuilder *builder, const char *text, Boolean escape )
+{
+    if ( escape ) {
+        EscapedText( builder, text );
+    } else {
+        XRRaw( builder, text, StrLen( text ) );
+    }
+}
+
+
+/*
+ * Name:   XRCallBegin(), XRCallEnd()
+ * Args:   builder - where to write
+ *         method - name of the method to call
+ * Return: none
+ * Desc:   Everything in between is the params.
+ */
+
+void XRCallBegin( XRBuilder *builder, const char *method )
+{
+    XRRaw( builder, LITERAL( XR_CALL_START ) );
+    XRText( builder, method, false );
+    XRRaw( builder, LITERAL( XR_CALL_PARAMS ) );
+}
+
+void XRCallEnd( XRBuilder *builder )
+{
+    XRRaw( builder, LITERAL( XR_CALL_CLOSE ) );
+}
+
+
+/*
+ * Name:   ValueBegin(), ValueEnd()
+ * Args:   builder - where to write
+ * Return: none
+ * Desc:   Wrap a value: as a param at the top level, and as the value of a
+ *         member or array element below that.  A member is opened by
+ *         XRMember() and closed here after its value.
+ */
+
+static void ValueBegin( XRBuilder *builder )
+{
+    if ( builder->depth == 0 ) {
+        XRRaw( builder, LITERAL( XR_PARAM_OPEN ) );
+    } else {
+        XRRaw( builder, LITERAL( "<value>" ) );
+    }
+}
+
+static void ValueEnd( XRBuilder *builder )
+{
+    if ( builder->depth == 0 ) {
+        XRRaw( builder, LITERAL( XR_PARAM_CLOSE ) );
+    } else if ( builder->structs & (1 << (builder->depth - 1)) ) {
+        XRRaw( builder, LITERAL( "</value></member>" ) );
+    } else {
+        XRRaw( builder, LITERAL( "</value>" ) );
+    }
+}
+
+
+/*
+ * Name:   Scalar()
+ * Args:   builder - where to write
+ *         open, openLen - the type tag
+ *         text - the value
+ *         escape - true if 'text' needs XML escaping
+ *         close, closeLen - the closing type tag
+ * Return: none
+ */
+
+static void Scalar( XRBuilder *builder, const char *open, UInt16 openLen,
+                    const char *text, Boolean escape, const char *close,
+                    UInt16 closeLen )
+{
+    ValueBegin( builder );
+    XRRaw( builder, open, openLen );
+    XRText( builder, text, escape );
+    XRRaw( builder, close, closeLen );
+    ValueEnd( builder );
+}
+
+
+/*
+ * Name:   XRString(), XRStringBegin(), XRStringEnd()
+ * Args:   builder - where to write
+ *         text - the string
+ *         escape - true if 'text' needs XML escaping
+ * Return: none
+ * Desc:   Between XRStringBegin() and XRStringEnd() the string is written
+ *         with XRText() and XRRaw().
+ */
+
+void XRString( XRBuilder *builder, const char *text, Boolean escape )
+{
+    Scalar( builder, LITERAL( "<string>" ), text, escape, 
+            LITERAL( "</string>" ) );
+}
+
+void XRStringBegin( XRBuilder *builder )
+{
+    ValueBegin( builder );
+    XRRaw( builder, LITERAL( "<string>" ) );
+}
+
+void XRStringEnd( XRBuilder *builder )
+{
+    XRRaw( builder, LITERAL( "</string>" ) );
+    ValueEnd( builder );
+}
+
+
+/*
+ * Name:   XRInt(), XRBoolean()
+ */
+
+void XRInt( XRBuilder *builder, Int32 value )
+{
+    char digits[maxStrIToALen];
+
+    StrIToA( digits, value );
+    Scalar( builder, LITERAL( "<int>" ), digits, false, 
+            LITERAL( "</int>" ) );
+}
+
+void XRBoolean( XRBuilder *builder, Boolean value )
+{
+    Scalar( builder, LITERAL( "<boolean>" ), value ? "1" : "0", false, 
+            LITERAL( "</boolean>" ) );
+}
+
+
+/*
+ * Name:   PutDigits()
+ * Args:   out - where to put the digits
+ *         value - number to write
+ *         count - number of digits, with leading zeros
+ * Return: none
+ */
+
+static void PutDigits( char *out, UInt16 value, UInt16 count )
+{
+    while ( count > 0 ) {
+        count--;
+        out[count] = '0' + (value % 10);
+        value /= 10;
+    }
+}
+
+
+/*
+ * Name:   XRDateTime()
+ * Args:   builder - where to write
+ *         when - the date and time
+ * Return: none
+ * Desc:   XML-RPC dates are ISO 8601 in the form 20050102T03:04:05, with no
+ *         time zone.
+ */
+
+void XRDateTime( XRBuilder *builder, const DateTimeType *when )
+{
+    char text[DATETIME_LEN + 1];
+
+    PutDigits( text, when->year, 4 );
+    PutDigits( text + 4, when->month, 2 );
+    PutDigits( text + 6, when->day, 2 );
+    text[8] = 'T';
+    PutDigits( text + 9, when->hour, 2 );
+    text[11] = ':';
+    PutDigits( text + 12, when->minute, 2 );
+    text[14] = ':';
+    PutDigits( text + 15, when->second, 2 );
+    text[DATETIME_LEN] = '\0';
+
+    Scalar( builder, LITERAL( "<dateTime.iso8601>" ), text, false,
+            LITERAL( "</dateTime.iso8601>" ) );
+}
+
+
+/*
+ * Name:   Nest(), Unnest()
+ * Args:   builder - where to write
+ *         isStruct - true for a struct, false for an array
+ * Return: none
+ * Desc:   Keeps track of whether values are going into a struct (and so
+ *         need their member closed) or an array.  Anything nested deeper
+ *         than XRB_MAX_DEPTH is treated as an array.
+ */
+
+static void Nest( XRBuilder *builder, Boolean isStruct )
+{
+    ValueBegin( builder );
+    builder->depth++;
+    if ( builder->depth <= XRB_MAX_DEPTH ) {
+        if ( isStruct ) {
+            builder->structs |= (1 << (builder->depth - 1));
+        } else {
+            builder->structs &= ~(1 << (builder->depth - 1));
+        }
+    }
+}
+
+static void Unnest( XRBuilder *builder )
+{
+    builder->depth--;
+    ValueEnd( builder );
+}
+
+
+/*
+ * Name:   XRStructBegin(), XRMember(), XRStructEnd()
+ * Args:   builder - where to write
+ *         name - name of the member the next value is for
+ * Return: none
+ */
+
+void XRStructBegin( XRBuilder *builder )
+{
+    Nest( builder, true );
+    XRRaw( builder, LITERAL( "<struct>" ) );
+}
+
+void XRMember( XRBuilder *builder, const char *name )
+{
+    XRRaw( builder, LITERAL( "<member><name>" ) );
+    XRText( builder, name, false );
+    XRRaw( builder, LITERAL( "</name>" ) );
+}
+
+void XRStructEnd( XRBuilder *builder )
+{
+    XRRaw( builder, LITERAL( "</struct>" ) );
+    Unnest( builder );
+}
+
+
+/*
+ * Name:   XRArrayBegin(), XRArrayEnd()
+ */
+
+void XRArrayBegin( XRBuilder *builder )
+{
+    Nest( builder, false );
+    XRRaw( builder, LITERAL( "<array><data>" ) );
+}
+
+void XRArrayEnd( XRBuilder *builder )
+{
+    XRRaw( builder, LITERAL( "</data></array>" ) );
+    Unnest( builder );
+}
+
+
+/*
+ * Name:   BuildWrite()
+ * Desc:   HTTPBodyFunc that runs an XRBuild into the send window.
+ */
+
+static void BuildWrite( void *ctx, HTTPWindow *window )
+{
+    XRBuild *build;
+    XRBuilder builder;
+
+    build = (XRBuild *)ctx;
+    XRBuilderWindow( &builder, window );
+    build->build( &builder, build->ctx );
+}
+
+
+/*
+ * Name:   XRBuildBody()
+ * Args:   build - the function that builds the request, and its context
+ *         body - filled in to send the request with HTTPPostBody()
+ * Return: none
+ * Desc:   Runs the build once to count it.  It's run again when the body
+ *         is sent, so 'build' and everything it uses has to stay put and
+ *         come out the same until then.
+ */
+
+void XRBuildBody( XRBuild *build, HTTPBody *body )
+{
+    XRBuilder builder;
+
+    XRBuilderCount( &builder );
+    build->build( &builder, build->ctx );
+
+    body->length = XRBuilderEnd( &builder );
+    body->write = BuildWrite;
+    body->ctx = build;
+}
+
+
+/*
+ * Name:   XRBuildString()
+ * Args:   build - the function that builds the request, and its context
+ *         buffer - where to put the request
+ *         size - size of 'buffer'
+ * Return: length of the request, or -1 if it didn't fit
+ */
+
+Int32 XRBuildString( XRBuild *build, char *buffer, UInt32 size )
+{
+    XRBuilder builder;
+
+    XRBuilderBuffer( &builder, buffer, size );
+    build->build( &builder, build->ctx );
+
+    return XRBuilderEnd( &builder );
+}
+
+
+/*
+ * Batched calls
+ */
+
+static const char *gMulticallName = "system.multicall";
+
+
+/*
+ * Name:   ParamBuild()
+ * Args:   builder - where to write
+ *         param - param to encode
+ * Return: none
+ * Desc:   XRBatchRun() has already checked the type is one of ours.
+ */
+
+static void ParamBuild( XRBuilder *builder, const XRParam *param )
+{
+    switch ( param->type ) {
+        case XRT_BOOLEAN:
+            Scalar( builder, LITERAL( "<boolean>" ), param->text, 
+                    param->escape, LITERAL( "</boolean>" ) );
+            break;
+
+        case XRT_INT:
+            Scalar( builder, LITERAL( "<int>" ), param->text, 
+                    param->escape, LITERAL( "</int>" ) );
+            break;
+
+        case XRT_DOUBLE:
+            Scalar( builder, LITERAL( "<double>" ), param->text, 
+                    param->escape, LITERAL( "</double>" ) );
+            break;
+
+        case XRT_DATETIME:
+            Scalar( builder, LITERAL( "<dateTime.iso8601>" ), param->text,
+                    param->escape, LITERAL( "</dateTime.iso8601>" ) );
+            break;
+
+        case XRT_BASE64:
+            Scalar( builder, LITERAL( "<base64>" ), param->text, 
+                    param->escape, LITERAL( "</base64>" ) );
+            break;
+
+        case XRT_NIL:
+            ValueBegin( builder );
+            XRRaw( builder, LITERAL( "<nil/>" ) );
+            ValueEnd( builder );
+            break;
+
+        default:
+            XRString( builder, param->text, param->escape );
+            break;
+    }
+}
+
+
+/*
+ * Name:   ParamsBuild()
+ * Args:   builder - where to write
+ *         call - the call whose params are wanted
+ * Return: none
+ */
+
+static void ParamsBuild( XRBuilder *builder, const XRCall *call )
+{
+    UInt16 i;
+
+    for ( i = 0; i < call->paramCount; i++ ) {
+        ParamBuild( builder, &(call->params[i]) );
+    }
+    if ( call->build != NULL ) {
+        call->build( builder, call->ctx );
+    }
+}
+
+
+/*
+ * Name:   CallBuild()
+ * Args:   builder - where to write
+ *         ctx - the XRCall
+ * Return: none
+ * Desc:   Encodes a call as a request on its own.
+ */
+
+static void CallBuild( XRBuilder *builder, void *ctx )
+{
+    const XRCall *call;
+
+    call = (const XRCall *)ctx;
+    XRCallBegin( builder, call->method );
+    ParamsBuild( builder, call );
+    XRCallEnd( builder );
+}
+
+
+/*
+ * Name:   MulticallBuild()
+ * Args:   builder - where to write
+ *         ctx - the XRBatch
+ * Return: none
+ * Desc:   Encodes every call in the batch as a single system.multicall.
+ *         Its one param is an array with a struct per call, holding the
+ *         method name and an array of the call's params.
+ */
+
+static void MulticallBuild( XRBuilder *builder, void *ctx )
+{
+    const XRBatch *batch;
+    const XRCall *call;
+    UInt16 i;
+
+    batch = (const XRBatch *)ctx;
+    XRCallBegin( builder, gMulticallName );
+    XRArrayBegin( builder );
+
+    for ( i = 0; i < batch->callCount; i++ ) {
+        call = &(batch->calls[i]);
+        XRStructBegin( builder );
+        XRMember( builder, "methodName" );
+        XRString( builder, call->method, false );
+        XRMember( builder, "params" );
+        XRArrayBegin( builder );
+        ParamsBuild( builder, call );
+        XRArrayEnd( builder );
+        XRStructEnd( builder );
+    }
+
+    XRArrayEnd( builder );
+    XRCallEnd( builder );
+}
+
+
+/*
+ * Name:   PostAndParse()
+ * Args:   url - server to post to
+ *         body - the request
+ *         tree - the response's params are added to the end of its root
+ *         fault - filled in if the response is a fault
+ * Return: 0 on success, -1 if the post failed, -2 if the response couldn't
+ *         be read or didn't fit in the tree's arena
+ */
+
+static int PostAndParse( URLTarget *url, HTTPBody *body, XRTree *tree,
+                         XRResult *fault )
+{
+    XRParser parser;
+
+    XRParserStart( &parser, XRTreeEvent, tree, fault );
+    if ( HTTPPostBody( url, body, NULL, XRParserWatch, &parser ) 
+            != HTTPErr_OK ) {
+        return -1;
+    }
+
+    if ( tree->failed || (XRParserEnd( &parser ) != 0) ) {
+        return -2;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   ProbeMulticall()
+ * Args:   as for XRBatchRun(), with 'arena' holding the caller's buffer
+ * Return: 0 if the server answered, -1 if it couldn't be reached
+ * Desc:   Asks the server for its method list and records whether
+ *         system.multicall is on it.  A server that faults or sends back
+ *         something we can't read is taken not to have it.
+ */
+
+static int ProbeMulticall( URLTarget *url, XRBatch *batch, XRArena *arena )
+{
+    XRCall probe;
+    XRBuild build;
+    HTTPBody body;
+    XRTree *tree;
+    XRNodeRef method;
+    int status;
+
+    MemSet( &probe, sizeof( XRCall ), 0 );
+    probe.method = "system.listMethods";
+
+    build.build = CallBuild;
+    build.ctx = &probe;
+    XRBuildBody( &build, &body );
+
+    tree = &(batch->tree);
+    XRArenaReset( arena );
+    if ( XRTreeStart( tree, arena ) != 0 ) {
+        status = -2;
+    } else {
+        status = PostAndParse( url, &body, tree, &probe.result );
+    }
+    if ( status == -1 ) {
+        return -1;
+    }
+
+    *batch->multicall = XR_MULTICALL_NO;
+    if ( (status != 0) || probe.result.fault ) {
+        return 0;
+    }
+
+    method = XRTreeFirst( tree, XRTreeFirst( tree, tree->root ) );
+    while ( method != XR_NO_NODE ) {
+        if ( StrCompare( XRTreeText( tree, method ), 
+                         gMulticallName ) == 0 ) {
+            *batch->multicall = XR_MULTICALL_YES;
+            break;
+        }
+        method = XRTreeNext( tree, method );
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   XRBatchRun()
+ * Args:   url - server to send the calls to
+ *         batch - the calls, results are filled in on each
+ *         buffer - where the batch's tree is built
+ *         bufferSize - size of 'buffer'
+ * Return: 0 if every call got an answer (which may be a fault), -1 if the
+ *         server couldn't be reached, -2 if a response couldn't be read,
+ *         -3 if a param has a type that can't be sent
+ * Desc:   Makes all of the calls in as few round trips as the server
+ *         allows.  Calls that never got an answer are left with a "Not
+ *         sent" fault, so the caller can tell what went through.
+ */
+
+int XRBatchRun( URLTarget *url, XRBatch *batch, char *buffer,
+                UInt32 bufferSize )
+{
+    XRBuild build;
+    HTTPBody body;
+    XRCall *call;
+    XRArena arena;
+    XRTree *tree;
+    XRResult fault;
+    UInt16 params;
+    UInt16 i;
+    UInt16 j;
+    int status;
+
+    for ( i = 0; i < batch->callCount; i++ ) {
+        call = &(batch->calls[i]);
+        for ( j = 0; j < call->paramCount; j++ ) {
+            if ( call->params[j].type > XRT_NIL ) {
+                return -3;
+            }
+        }
+        call->result.fault = true;
+        call->result.faultCode = 0;
+        StrCopy( call->result.text, "Not sent" );
+        call->value = XR_NO_NODE;
+    }
+
+    /* The tree goes straight into the caller's buffer */
+    arena.base = buffer;
+    arena.size = bufferSize;
+    arena.used = 0;
+
+    if ( (batch->callCount > 1) && 
+            (*batch->multicall == XR_MULTICALL_UNKNOWN) ) {
+        if ( ProbeMulticall( url, batch, &arena ) != 0 ) {
+            return -1;
+        }
+    }
+
+    tree = &(batch->tree);
+    XRArenaReset( &arena );
+    if ( XRTreeStart( tree, &arena ) != 0 ) {
+        return -2;
+    }
+
+    if ( (batch->callCount > 1) && 
+            (*batch->multicall == XR_MULTICALL_YES) ) {
+        build.build = MulticallBuild;
+        build.ctx = batch;
+        XRBuildBody( &build, &body );
+
+        status = PostAndParse( url, &body, tree, &fault );
+        if ( status != 0 ) {
+            return status;
+        }
+
+        if ( fault.fault ) {
+            FaultText( &fault );
+            for ( i = 0; i < batch->callCount; i++ ) {
+                batch->calls[i].result = fault;
+            }
+            return 0;
+        }
+
+        return MulticallResults( tree, batch );
+    }
+
+    /* Each response's value goes on the end of the same root */
+    for ( i = 0; i < batch->callCount; i++ ) {
+        call = &(batch->calls[i]);
+        build.build = CallBuild;
+        build.ctx = call;
+        XRBuildBody( &build, &body );
+
+        params = XRTreeNode( tree, tree->root )->length;
+        status = PostAndParse( url, &body, tree, &fault );
+        if ( status != 0 ) {
+            return status;
+        }
+
+        if ( fault.fault ) {
+            FaultText( &fault );
+            call->result = fault;
+        } else if ( XRTreeNode( tree, tree->root )->length == params ) {
+            return -2;
+        } else {
+            call->value = tree->last[0];
+            ScalarResult( tree, call->value, &(call->result) );
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   FaultText()
+ * Args:   result - a fault
+ * Return: none
+ * Desc:   Gives a fault that came without a string something to say.
+ */
+
+static void FaultText( XRResult *result )
+{
+    if ( result->text[0] == '\0' ) {
+        StrCopy( result->text, "Unknown fault" );
+    }
+}
+
+
+/*
+ * Name:   ScalarResult()
+ * Args:   tree - the response
+ *         value - the value a call returned
+ *         result - filled in with its text
+ * Return: none
+ * Desc:   Structs and arrays give an empty string, long values are cut off
+ *         to fit.
+ */
+
+static void ScalarResult( XRTree *tree, XRNodeRef value, XRResult *result )
+{
+    result->fault = false;
+    result->faultCode = 0;
+    StrNCopy( result->text, XRTreeText( tree, value ), XR_RESULT_LEN - 1 );
+    result->text[XR_RESULT_LEN - 1] = '\0';
+}
+
+
+/*
+ * Name:   FaultResult()
+ * Args:   tree - the response
+ *         value - a fault struct
+ *         result - filled in with the fault code and string
+ * Return: none
+ */
+
+static void FaultResult( XRTree *tree, XRNodeRef value, XRResult *result )
+{
+    ScalarResult( tree, XRTreeMember( tree, value, "faultString" ), result );
+    result->fault = true;
+    result->faultCode = StrAToI( XRTreeText( tree, 
+                                 XRTreeMember( tree, value, "faultCode" ) ) );
+    FaultText( result );
+}
+
+
+/*
+ * Name:   MulticallResults()
+ * Args:   tree - the system.multicall response
+ *         batch - the calls to fill in results for, in order
+ * Return: 0 on success, -2 if the response couldn't be made sense of
+ * Desc:   The response is an array with one entry per call.  A call that
+ *         worked gets a one element array holding its result, one that
+ *         failed gets a fault struct.
+ */
+
+static int MulticallResults( XRTree *tree, XRBatch *batch )
+{
+    XRNodeRef entry;
+    XRNode *node;
+    XRCall *call;
+    UInt16 i;
+
+    entry = XRTreeFirst( tree, XRTreeFirst( tree, tree->root ) );
+
+    for ( i = 0; i < batch->callCount; i++ ) {
+        call = &(batch->calls[i]);
+        node = XRTreeNode( tree, entry );
+        if ( node == NULL ) {
+            return -2;
+        }
+
+        if ( node->type == XRN_ARRAY ) {
+            call->value = XRTreeFirst( tree, entry );
+            ScalarResult( tree, call->value, &(call->result) );
+        } else if ( node->type == XRN_STRUCT ) {
+            FaultResult( tree, entry, &(call->result) );
+        } else {
+            return -2;
+        }
+
+        entry = XRTreeNext( tree, entry );
+    }
+
+    return 0;
+}
+
+
+/*
+ * Media uploads.  Base64 is read 3 bytes at a time, so every window but the
+ * last is a multiple of 3 and only the end of the file gets padding.
+ */
+
+#define BASE64_IN_SIZE (96)
+#define BASE64_OUT_SIZE ((BASE64_IN_SIZE / 3) * 4)
+
+static const char gBase64Chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+/*
+ * Name:   XRSourceOpenStream()
+ * Args:   source - filled in to read from the stream
+ *         name - name of the file stream DB
+ * Return: 0 on success, -1 if the stream couldn't be opened
+ */
+
+int XRSourceOpenStream( XRSource *source, const char *name )
+{
+    Int32 size;
+
+    source->kind = XRS_STREAM;
+    source->stream = FileOpen( 0, name, 0, 0, fileModeReadOnly, NULL );
+    if ( source->stream == NULL ) {
+        return -1;
+    }
+
+    FileTell( source->stream, &size, NULL );
+    source->size = size;
+
+    return 0;
+}
+
+
+/*
+ * Name:   XRSourceOpenVFS()
+ * Args:   source - filled in to read from the file
+ *         volRef - volume the file is on
+ *         path - full path to the file
+ * Return: 0 on success, -1 if the file couldn't be opened
+ */
+
+int XRSourceOpenVFS( XRSource *source, UInt16 volRef, const char *path )
+{
+    source->kind = XRS_VFS;
+    if ( VFSFileOpen( volRef, path, vfsModeRead, &source->file ) != errNone ) {
+        return -1;
+    }
+
+    if ( VFSFileSize( source->file, &source->size ) != errNone ) {
+        VFSFileClose( source->file );
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   XRSourceClose()
+ */
+
+void XRSourceClose( XRSource *source )
+{
+    if ( source->kind == XRS_STREAM ) {
+        FileClose( source->stream );
+    } else {
+        VFSFileClose( source->file );
+    }
+}
+
+
+/*
+ * Name:   SourceRead()
+ * Args:   source - where to read from
+ *         buffer - where to put the data
+ *         length - bytes wanted
+ * Return: bytes read, less than 'length' only at the end or on an error
+ */
+
+static UInt32 SourceRead( XRSource *source, UInt8 *buffer, UInt32 length )
+{
+    UInt32 filled;
+    UInt32 thisRead;
+
+    filled = 0;
+    while ( filled < length ) {
+        if ( source->kind == XRS_STREAM ) {
+            thisRead = FileRead( source->stream, buffer + filled, 1, 
+                                 length - filled, NULL );
+        } else {
+            thisRead = 0;
+            VFSFileRead( source->file, length - filled, buffer + filled, 
+                         &thisRead );
+        }
+        if ( thisRead == 0 ) {
+            break;
+        }
+        filled += thisRead;
+    }
+
+    return filled;
+}
+
+
+/*
+ * Name:   XRBase64()
+ * Args:   builder - where to write
+ *         source - file to encode
+ * Return: none
+ * Desc:   Encodes 'source->size' bytes of the source.  Counting doesn't
+ *         touch the source, so it's still at its start for the real run.
+ *         If the source runs short it stops, and a post fails on the
+ *         length not matching what was promised.
+ */
+
+void XRBase64( XRBuilder *builder, XRSource *source )
+{
+    UInt8 in[BASE64_IN_SIZE];
+    char out[BASE64_OUT_SIZE];
+    UInt32 remaining;
+    UInt32 want;
+    UInt32 got;
+    UInt32 i;
+    UInt16 outLen;
+    UInt32 bits;
+
+    ValueBegin( builder );
+    XRRaw( builder, LITERAL( "<base64>" ) );
+
+    if ( builder->sink == XRB_COUNT ) {
+        builder->length += XR_BASE64_LENGTH( source->size );
+        remaining = 0;
+    } else {
+        remaining = source->size;
+    }
+
+    while ( remaining > 0 ) {
+        want = remaining;
+        if ( want > BASE64_IN_SIZE ) {
+            want = BASE64_IN_SIZE;
+        }
+        got = SourceRead( source, in, want );
+        if ( got != want ) {
+            return;
+        }
+
+        outLen = 0;
+        for ( i = 0; i + 2 < got; i += 3 ) {
+            bits = ((UInt32)in[i] << 16) | ((UInt32)in[i + 1] << 8) | 
+                   in[i + 2];
+            out[outLen++] = gBase64Chars[(bits >> 18) & 0x3F];
+            out[outLen++] = gBase64Chars[(bits >> 12) & 0x3F];
+            out[outLen++] = gBase64Chars[(bits >> 6) & 0x3F];
+            out[outLen++] = gBase64Chars[bits & 0x3F];
+        }
+        if ( i < got ) {
+            bits = (UInt32)in[i] << 16;
+            if ( i + 1 < got ) {
+                bits |= (UInt32)in[i + 1] << 8;
+            }
+            out[outLen++] = gBase64Chars[(bits >> 18) & 0x3F];
+            out[outLen++] = gBase64Chars[(bits >> 12) & 0x3F];
+            if ( i + 1 < got ) {
+                out[outLen++] = gBase64Chars[(bits >> 6) & 0x3F];
+            } else {
+                out[outLen++] = '=';
+            }
+            out[outLen++] = '=';
+        }
+
+        XRRaw( builder, out, outLen );
+        remaining -= got;
+    }
+
+    XRRaw( builder, LITERAL( "</base64>" ) );
+    ValueEnd( builder );
+}
+
+
+/*
+ * Name:   MediaBuild()
+ * Args:   builder - where to write
+ *         ctx - the XRMedia
+ * Return: none
+ */
+
+static void MediaBuild( XRBuilder *builder, void *ctx )
+{
+    XRMedia *media;
+
+    media = (XRMedia *)ctx;
+    XRCallBegin( builder, "metaWeblog.newMediaObject" );
+    XRString( builder, media->blogID, true );
+    XRString( builder, media->name, false );
+    XRString( builder, media->pass, false );
+    XRStructBegin( builder );
+    XRMember( builder, "name" );
+    XRString( builder, media->fileName, true );
+    XRMember( builder, "type" );
+    XRString( builder, media->mimeType, false );
+    XRMember( builder, "bits" );
+    XRBase64( builder, media->source );
+    XRStructEnd( builder );
+    XRCallEnd( builder );
+}
+
+
+/*
+ * Name:   XRMediaBody()
+ * Args:   media - the upload, with its source already open
+ *         body - filled in to send the upload with HTTPPostBody()
+ * Return: none
+ * Desc:   The source has to be at its start, and is read through to the
+ *         end when the body is sent.
+ */
+
+void XRMediaBody( XRMedia *media, HTTPBody *body )
+{
+    media->build.build = MediaBuild;
+    media->build.ctx = media;
+    XRBuildBody( &media->build, body );
+}
+
+
+/*
+ * Response parsing.  The tokenizer (XRParser.lex) is in one of the LX_
+ * states between characters.  'match' counts how much of a multi character
+ * terminator ("-->", "?>", "]]>") has gone by.  Tag names are folded to
+ * lower case and looked up in gElements, anything not there is ignored.
+ * 'collect' says what the text between tags is being kept for, and it's
+ * decoded on the way into 'text'.
+ */
+
+#define LX_TEXT (0)
+#define LX_TAG_OPEN (1)
+#define LX_TAG_NAME (2)
+#define LX_TAG_REST (3)
+#define LX_PI (4)
+#define LX_BANG (5)
+#define LX_COMMENT (6)
+#define LX_CDATA (7)
+#define LX_DECL (8)
+
+#define PS_RUNNING (0)
+#define PS_DONE (1)
+#define PS_STOPPED (2)
+#define PS_ERROR (3)
+
+#define CT_NONE (0)
+#define CT_VALUE (1)
+#define CT_NAME (2)
+
+#define FM_OTHER (0)
+#define FM_CODE (1)
+#define FM_STRING (2)
+
+#define EL_UNKNOWN (0)
+#define EL_RESPONSE (1)
+#define EL_FAULT (2)
+#define EL_VALUE (3)
+#define EL_STRUCT (4)
+#define EL_ARRAY (5)
+#define EL_NAME (6)
+#define EL_TYPE (7)
+
+typedef struct Element_struct {
+    const char *name;
+    UInt8 element;
+    UInt8 type;
+} Element;
+
+static const Element gElements[] = {
+    { "methodresponse", EL_RESPONSE, 0 },
+    { "fault", EL_FAULT, 0 },
+    { "value", EL_VALUE, 0 },
+    { "struct", EL_STRUCT, 0 },
+    { "array", EL_ARRAY, 0 },
+    { "name", EL_NAME, 0 },
+    { "string", EL_TYPE, XRT_STRING },
+    { "int", EL_TYPE, XRT_INT },
+    { "i4", EL_TYPE, XRT_INT },
+    { "i8", EL_TYPE, XRT_INT },
+    { "boolean", EL_TYPE, XRT_BOOLEAN },
+    { "double", EL_TYPE, XRT_DOUBLE },
+    { "datetime.iso8601", EL_TYPE, XRT_DATETIME },
+    { "base64", EL_TYPE, XRT_BASE64 },
+    { "nil", EL_TYPE, XRT_NIL },
+    { NULL, EL_UNKNOWN, 0 }
+};
+
+static const char gCDATAStart[] = "[CDATA[";
+
+/*
+ * Comments and processing instructions are skipped by searching for their
+ * ends, the searchers are set up the first time a parse starts.
+ */
+
+static HTTPSearch gCommentEnd;
+static HTTPSearch gPIEnd;
+static Boolean gSearchReady = false;
+
+
+/*
+ * Text decoding.  gDecodeClass says what each byte of text starts: a plain
+ * character, an entity, or a UTF-8 sequence of that many bytes.  Bytes
+ * that can't start a sequence (continuation bytes on their own, overlong
+ * and out of range leads) are DC_LATIN and kept as they are, as are
+ * sequences that don't finish, so a server sending Latin-1 still works.
+ * Only the five XML entities are known by name.
+ */
+
+#define DC_PLAIN (0)
+#define DC_ENTITY (1)
+#define DC_UTF8_2 (2)
+#define DC_UTF8_3 (3)
+#define DC_UTF8_4 (4)
+#define DC_LATIN (5)
+
+static const UInt8 gDecodeClass[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x00 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x10 */
+    0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x20 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x30 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x40 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x50 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x60 */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  /* 0x70 */
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,  /* 0x80 */
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,  /* 0x90 */
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,  /* 0xA0 */
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,  /* 0xB0 */
+    5, 5, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,  /* 0xC0 */
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,  /* 0xD0 */
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,  /* 0xE0 */
+    4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5   /* 0xF0 */
+};
+
+typedef struct Entity_struct {
+    const char *name;
+    char ch;
+} Entity;
+
+static const Entity gEntities[] = {
+    { "amp", '&' },
+    { "lt", '<' },
+    { "gt", '>' },
+    { "quot", '"' },
+    { "apos", '\'' },
+    { NULL, '\0' }
+};
+
+#define ENTITY_CHAR( ch ) \
+    ((((ch) >= 'a') && ((ch) <= 'z')) || (((ch) >= 'A') && ((ch) <= 'Z')) || \
+     (((ch) >= '0') && ((ch) <= '9')) || ((ch) == '#'))
+
+#define ENTITY_DIGIT( ch ) \
+    ((((ch) >= '0') && ((ch) <= '9')) ? ((ch) - '0') : \
+     (((ch) >= 'a') && ((ch) <= 'f')) ? ((ch) - 'a' + 10) : \
+     (((ch) >= 'A') && ((ch) <= 'F')) ? ((ch) - 'A' + 10) : 16)
+
+#define XML_SPACE( ch ) \
+    (((ch) == ' ') || ((ch) == '\t') || ((ch) == '\r') || ((ch) == '\n'))
+
+
+/*
+ * Name:   XRParserStart()
+ * Args:   parser - parser to set up
+ *         func - called with each event
+ *         ctx - passed to 'func'
+ *         fault - filled in if the response is a fault, may be NULL
+ * Return: none
+ */
+
+void XRParserStart( XRParser *parser, XREventFunc func, void *ctx,
+                    XRResult *fault )
+{
+    MemSet( parser, sizeof( XRParser ), 0 );
+    parser->lex = LX_TEXT;
+    parser->status = PS_RUNNING;
+    parser->func = func;
+    parser->ctx = ctx;
+    parser->fault = fault;
+
+    if ( !gSearchReady ) {
+        HTTPSearchInit( &gCommentEnd, "-->" );
+        HTTPSearchInit( &gPIEnd, "?>" );
+        gSearchReady = true;
+    }
+
+    if ( fault != NULL ) {
+        fault->fault = false;
+        fault->faultCode = 0;
+        fault->text[0] = '\0';
+    }
+}
+
+
+/*
+ * Name:   ElementFor()
+ * Args:   tag - lower case tag name
+ * Return: index into gElements, the terminating entry if it's not there
+ */
+
+static UInt8 ElementFor( const char *tag )
+{
+    UInt8 i;
+
+    for ( i = 0; gElements[i].name != NULL; i++ ) {
+        if ( StrCompare( tag, gElements[i].name ) == 0 ) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+
+/*
+ * Name:   Event()
+ * Args:   parser - the parser
+ *         kind - one of the XRE_ values
+ *         partial - true if more of this value's text is to come
+ * Return: none
+ * Desc:   Sends an event made from the parser's current state, and empties
+ *         the text buffer.  Events inside a fault go to FaultEvent()
+ *         instead.
+ */
+
+static void Event( XRParser *parser, UInt8 kind, Boolean partial )
+{
+    XREvent event;
+
+    parser->text[parser->textLen] = '\0';
+    event.kind = kind;
+    event.type = parser->type;
+    event.depth = parser->depth;
+    event.partial = partial;
+    event.text = parser->text;
+    event.length = parser->textLen;
+    parser->textLen = 0;
+
+    if ( parser->inFault ) {
+        FaultEvent( parser, &event );
+    } else if ( (parser->func != NULL) && 
+                parser->func( parser->ctx, &event ) ) {
+        parser->status = PS_STOPPED;
+    }
+}
+
+
+/*
+ * Name:   FaultEvent()
+ * Args:   parser - the parser
+ *         event - event from inside the fault
+ * Return: none
+ * Desc:   A fault is a struct with faultCode and faultString members.
+ */
+
+static void FaultEvent( XRParser *parser, XREvent *event )
+{
+    XRResult *fault;
+    UInt16 room;
+
+    fault = parser->fault;
+    if ( fault == NULL ) {
+        return;
+    }
+
+    if ( event->kind == XRE_MEMBER ) {
+        parser->faultMember = FM_OTHER;
+        if ( event->depth == 1 ) {
+            if ( StrCaselessCompare( event->text, "faultCode" ) == 0 ) {
+                parser->faultMember = FM_CODE;
+            } else if ( StrCaselessCompare( event->text, 
+                                            "faultString" ) == 0 ) {
+                parser->faultMember = FM_STRING;
+            }
+        }
+    } else if ( event->kind == XRE_VALUE ) {
+        if ( parser->faultMember == FM_CODE ) {
+            fault->faultCode = StrAToI( event->text );
+        } else if ( parser->faultMember == FM_STRING ) {
+            room = (XR_RESULT_LEN - 1) - parser->faultLen;
+            if ( event->length < room ) {
+                room = event->length;
+            }
+            MemMove( fault->text + parser->faultLen, event->text, room );
+            parser->faultLen += room;
+            fault->text[parser->faultLen] = '\0';
+        }
+    }
+}
+
+
+/*
+ * Name:   KeepChar()
+ * Args:   parser - the parser
+ *         ch - a decoded character of text between tags
+ * Return: none
+ * Desc:   Keeps the character if it's part of a value or name.  A full
+ *         buffer of value text goes out as a partial value, unless it's
+ *         only the whitespace in front of a struct or array.  Names are
+ *         just cut off.
+ */
+
+static void KeepChar( XRParser *parser, char ch )
+{
+    UInt16 i;
+
+    if ( parser->collect == CT_NONE ) {
+        return;
+    }
+
+    if ( parser->textLen == (XR_TEXT_LEN - 1) ) {
+        if ( parser->collect == CT_NAME ) {
+            return;
+        }
+        for ( i = 0; i < parser->textLen; i++ ) {
+            if ( !XML_SPACE( parser->text[i] ) ) {
+                break;
+            }
+        }
+        if ( (i == parser->textLen) && !parser->partialSent ) {
+            parser->textLen = 0;
+        } else {
+            Event( parser, XRE_VALUE, true );
+            parser->partialSent = true;
+        }
+    }
+
+    parser->text[parser->textLen++] = ch;
+}
+
+
+/*
+ * Name:   PalmChar()
+ * Args:   code - a Unicode code point
+ * Return: the Palm character for it, XR_FALLBACK_CHAR if there isn't one
+ */
+
+static char PalmChar( UInt32 code )
+{
+    UInt8 i;
+
+    if ( ((code > 0) && (code < 0x80)) || 
+            ((code >= 0xA0) && (code <= 0xFF)) ) {
+        return (char)code;
+    }
+
+    for ( i = 0; i < 32; i++ ) {
+        if ( (gPalmHighToUnicode[i] != 0) && 
+                (gPalmHighToUnicode[i] == code) ) {
+            return (char)(0x80 + i);
+        }
+    }
+
+    return XR_FALLBACK_CHAR;
+}
+
+
+/*
+ * Name:   FlushDecode()
+ * Args:   parser - the parser
+ * Return: none
+ * Desc:   Whatever was held back as the start of an entity or a UTF-8
+ *         sequence turned out not to be one, so it's kept as it is.
+ */
+
+static void FlushDecode( XRParser *parser )
+{
+    UInt8 length;
+    UInt8 i;
+
+    length = parser->entityLen;
+    parser->entityLen = 0;
+    for ( i = 0; i < length; i++ ) {
+        KeepChar( parser, parser->entity[i] );
+    }
+
+    length = parser->seqLen;
+    parser->seqLen = 0;
+    for ( i = 0; i < length; i++ ) {
+        KeepChar( parser, parser->seq[i] );
+    }
+}
+
+
+/*
+ * Name:   DecodeByte()
+ * Args:   parser - the parser
+ *         ch - a byte of text, outside any entity
+ * Return: none
+ * Desc:   Puts UTF-8 sequences back together, held in 'seq' until the
+ *         last byte arrives.
+ */
+
+static void DecodeByte( XRParser *parser, char ch )
+{
+    UInt8 cls;
+    UInt8 i;
+    UInt32 code;
+
+    if ( parser->seqLen > 0 ) {
+        if ( ((UInt8)ch & 0xC0) == 0x80 ) {
+            parser->seq[parser->seqLen++] = ch;
+            if ( parser->seqLen < parser->seqNeed ) {
+                return;
+            }
+            code = (UInt8)parser->seq[0] & (0x7F >> parser->seqNeed);
+            for ( i = 1; i < parser->seqNeed; i++ ) {
+                code = (code << 6) | ((UInt8)parser->seq[i] & 0x3F);
+            }
+            parser->seqLen = 0;
+            KeepChar( parser, PalmChar( code ) );
+            return;
+        }
+        FlushDecode( parser );
+    }
+
+    cls = gDecodeClass[(UInt8)ch];
+    if ( (cls >= DC_UTF8_2) && (cls <= DC_UTF8_4) ) {
+        parser->seq[0] = ch;
+        parser->seqLen = 1;
+        parser->seqNeed = cls;
+        return;
+    }
+
+    KeepChar( parser, ch );
+}
+
+
+/*
+ * Name:   EndEntity()
+ * Args:   parser - the parser, with an entity up to its ';' in 'entity'
+ * Return: none
+ * Desc:   Character references are decoded by number, other entities by
+ *         name.  One we don't know is kept as it was.
+ */
+
+static void EndEntity( XRParser *parser )
+{
+    const char *name;
+    UInt32 code;
+    UInt8 base;
+    UInt8 digit;
+    UInt8 i;
+
+    parser->entity[parser->entityLen] = '\0';
+    name = parser->entity + 1;
+
+    if ( *name == '#' ) {
+        name++;
+        base = 10;
+        if ( (*name == 'x') || (*name == 'X') ) {
+            base = 16;
+            name++;
+        }
+
+        code = 0;
+        digit = (*name == '\0') ? 16 : 0;
+        while ( (*name != '\0') && (digit < base) ) {
+            digit = ENTITY_DIGIT( *name );
+            if ( (digit < base) && (code <= 0x10FFFF) ) {
+                code = (code * base) + digit;
+            }
+            name++;
+        }
+
+        if ( digit < base ) {
+            parser->entityLen = 0;
+            KeepChar( parser, PalmChar( code ) );
+            return;
+        }
+    } else {
+        for ( i = 0; gEntities[i].name != NULL; i++ ) {
+            if ( StrCompare( name, gEntities[i].name ) == 0 ) {
+                parser->entityLen = 0;
+                KeepChar( parser, gEntities[i].ch );
+                return;
+            }
+        }
+    }
+
+    parser->entity[parser->entityLen++] = ';';
+    FlushDecode( parser );
+}
+
+
+/*
+ * Name:   AddText()
+ * Args:   parser - the parser
+ *         ch - a character of text between tags, as it arrived
+ * Return: none
+ * Desc:   Entities are held in 'entity' until their ';' turns up, so they
+ *         can be split between pieces of the response like anything else.
+ */
+
+static void AddText( XRParser *parser, char ch )
+{
+    if ( parser->collect == CT_NONE ) {
+        return;
+    }
+
+    if ( parser->entityLen > 0 ) {
+        if ( ch == ';' ) {
+            EndEntity( parser );
+            return;
+        }
+        if ( (parser->entityLen < (XR_ENTITY_LEN - 2)) &&
+                ENTITY_CHAR( ch ) ) {
+            parser->entity[parser->entityLen++] = ch;
+            return;
+        }
+        FlushDecode( parser );
+    }
+
+    if ( gDecodeClass[(UInt8)ch] == DC_ENTITY ) {
+        FlushDecode( parser );
+        parser->entity[0] = ch;
+        parser->entityLen = 1;
+        return;
+    }
+
+    DecodeByte( parser, ch );
+}
+
+
+/*
+ * Name:   StartElement(), EndElement()
+ * Args:   parser - the parser
+ *         element - index into gElements of the tag
+ * Return: none
+ * Desc:   The XML-RPC part of the parse.  'valueDone' is set once the
+ *         current value has gone out as an event or turned out to be a
+ *         struct or array, so a <value> with no type inside can be sent as
+ *         a string when it closes.
+ */
+
+static void StartElement( XRParser *parser, UInt8 element )
+{
+    switch ( gElements[element].element ) {
+        case EL_FAULT:
+            parser->inFault = true;
+            if ( parser->fault != NULL ) {
+                parser->fault->fault = true;
+            }
+            break;
+
+        case EL_VALUE:
+            parser->collect = CT_VALUE;
+            parser->textLen = 0;
+            parser->type = XRT_STRING;
+            parser->valueDone = false;
+            parser->partialSent = false;
+            break;
+
+        case EL_TYPE:
+            parser->collect = CT_VALUE;
+            parser->textLen = 0;
+            parser->type = gElements[element].type;
+            parser->partialSent = false;
+            break;
+
+        case EL_STRUCT:
+        case EL_ARRAY:
+            /* 'depth' would wrap, nothing real nests this deep */
+            if ( parser->depth == 0xFF ) {
+                parser->status = PS_ERROR;
+                break;
+            }
+            parser->collect = CT_NONE;
+            parser->textLen = 0;
+            parser->valueDone = true;
+            Event( parser, (gElements[element].element == EL_STRUCT) ?
+                           XRE_STRUCT_BEGIN : XRE_ARRAY_BEGIN, false );
+            parser->depth++;
+            break;
+
+        case EL_NAME:
+            parser->collect = CT_NAME;
+            parser->textLen = 0;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void EndElement( XRParser *parser, UInt8 element )
+{
+    switch ( gElements[element].element ) {
+        case EL_RESPONSE:
+            parser->collect = CT_NONE;
+            parser->textLen = 0;
+            if ( parser->status == PS_RUNNING ) {
+                Event( parser, XRE_DONE, false );
+            }
+            if ( parser->status == PS_RUNNING ) {
+                parser->status = PS_DONE;
+            }
+            break;
+
+        case EL_FAULT:
+            parser->inFault = false;
+            break;
+
+        case EL_VALUE:
+        case EL_TYPE:
+            if ( !parser->valueDone && (parser->collect == CT_VALUE) ) {
+                Event( parser, XRE_VALUE, false );
+            }
+            parser->collect = CT_NONE;
+            parser->valueDone = true;
+            break;
+
+        case EL_STRUCT:
+        case EL_ARRAY:
+            if ( parser->depth == 0 ) {
+                parser->status = PS_ERROR;
+                break;
+            }
+            parser->depth--;
+            parser->textLen = 0;
+            Event( parser, (gElements[element].element == EL_STRUCT) ?
+                           XRE_STRUCT_END : XRE_ARRAY_END, false );
+            break;
+
+        case EL_NAME:
+            if ( parser->collect == CT_NAME ) {
+                Event( parser, XRE_MEMBER, false );
+            }
+            parser->collect = CT_NONE;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/*
+ * Name:   TagDone()
+ * Args:   parser - the parser, with the tag just read
+ * Return: none
+ * Desc:   An empty element tag (<value/>) is a start and an end at once.
+ */
+
+static void TagDone( XRParser *parser )
+{
+    UInt8 element;
+
+    parser->tag[parser->tagLen] = '\0';
+    element = ElementFor( parser->tag );
+
+    if ( parser->closing ) {
+        EndElement( parser, element );
+    } else {
+        StartElement( parser, element );
+        if ( parser->empty && (parser->status == PS_RUNNING) ) {
+            EndElement( parser, element );
+        }
+    }
+
+    parser->lex = LX_TEXT;
+}
+
+
+/*
+ * Name:   KeepRun()
+ * Args:   parser - the parser
+ *         run - plain text, with nothing in it to decode
+ *         length - bytes in 'run'
+ * Return: none
+ * Desc:   The same as KeepChar() on each character, but copies as much at
+ *         a time as fits in the text buffer.
+ */
+
+static void KeepRun( XRParser *parser, const char *run, UInt32 length )
+{
+    UInt32 room;
+
+    while ( (length > 0) && (parser->status == PS_RUNNING) ) {
+        room = (XR_TEXT_LEN - 1) - parser->textLen;
+        if ( room == 0 ) {
+            KeepChar( parser, *run++ );
+            length--;
+            continue;
+        }
+        if ( room > length ) {
+            room = length;
+        }
+        MemMove( parser->text + parser->textLen, run, room );
+        parser->textLen += room;
+        run += room;
+        length -= room;
+    }
+}
+
+
+/*
+ * Name:   SkipAhead()
+ * Args:   parser - the parser
+ *         data - the next byte to be parsed
+ *         end - just past the last byte of the piece
+ * Return: how far the parse got, 'data' if the next byte has to go through
+ *         XRParserFeed() one at a time
+ * Desc:   The fast paths.  Text that isn't being kept is skipped to the
+ *         next tag, and a run of plain text that is kept is copied in one
+ *         go.  Comments, processing instructions and declarations are
+ *         skipped to their ends.  Once part of an end has been seen
+ *         ('match' isn't 0) it's finished a byte at a time.
+ */
+
+static const char *SkipAhead( XRParser *parser, const char *data,
+                              const char *end )
+{
+    const char *found;
+    const char *run;
+    const HTTPSearch *search;
+
+    switch ( parser->lex ) {
+        case LX_TEXT:
+            if ( parser->collect == CT_NONE ) {
+                found = HTTPSpanChr( data, end, '<' );
+                return ( found != NULL ) ? found : end;
+            }
+            if ( (parser->entityLen != 0) || (parser->seqLen != 0) ) {
+                return data;
+            }
+            run = data;
+            while ( (run < end) && (*run != '<') &&
+                    (gDecodeClass[(UInt8)*run] == DC_PLAIN) ) {
+                run++;
+            }
+            KeepRun( parser, data, run - data );
+            return run;
+
+        case LX_COMMENT:
+        case LX_PI:
+            if ( parser->match != 0 ) {
+                return data;
+            }
+            search = (parser->lex == LX_COMMENT) ? &gCommentEnd : &gPIEnd;
+            found = HTTPSearchSpan( search, data, end );
+            if ( found != NULL ) {
+                parser->lex = LX_TEXT;
+                return found + search->length;
+            }
+            parser->match = HTTPSearchTail( search, data, end );
+            return end;
+
+        case LX_DECL:
+            found = HTTPSpanChr( data, end, '>' );
+            if ( found != NULL ) {
+                parser->lex = LX_TEXT;
+                return found + 1;
+            }
+            return end;
+
+        default:
+            return data;
+    }
+}
+
+
+/*
+ * Name:   XRParserFeed()
+ * Args:   parser - the parser
+ *         data - the next piece of the response
+ *         length - bytes in 'data'
+ * Return: true once the parse is over (the response ended, the event
+ *         function stopped it, or it wasn't XML-RPC), false if it wants
+ *         more
+ * Desc:   Pieces can be split anywhere, even in the middle of a tag.
+ */
+
+Boolean XRParserFeed( XRParser *parser, const char *data, UInt32 length )
+{
+    const char *end;
+    const char *skipped;
+    char ch;
+
+    end = data + length;
+    while ( (data < end) && (parser->status == PS_RUNNING) ) {
+        skipped = SkipAhead( parser, data, end );
+        if ( skipped != data ) {
+            data = skipped;
+            continue;
+        }
+
+        ch = *data++;
+
+        switch ( parser->lex ) {
+            case LX_TEXT:
+                if ( ch == '<' ) {
+                    FlushDecode( parser );
+                    parser->lex = LX_TAG_OPEN;
+                } else {
+                    AddText( parser, ch );
+                }
+                break;
+
+            case LX_TAG_OPEN:
+                parser->closing = false;
+                parser->empty = false;
+                parser->tagLen = 0;
+                parser->match = 0;
+                if ( ch == '/' ) {
+                    parser->closing = true;
+                    parser->lex = LX_TAG_NAME;
+                } else if ( ch == '?' ) {
+                    parser->lex = LX_PI;
+                } else if ( ch == '!' ) {
+                    parser->lex = LX_BANG;
+                } else {
+                    parser->lex = LX_TAG_NAME;
+                    data--;
+                }
+                break;
+
+            case LX_TAG_NAME:
+                if ( ch == '>' ) {
+                    TagDone( parser );
+                } else if ( ch == '/' ) {
+                    parser->empty = true;
+                    parser->lex = LX_TAG_REST;
+                } else if ( XML_SPACE( ch ) ) {
+                    parser->lex = LX_TAG_REST;
+                } else if ( parser->tagLen < (XR_TAG_LEN - 1) ) {
+                    if ( (ch >= 'A') && (ch <= 'Z') ) {
+                        ch += 'a' - 'A';
+                    }
+                    parser->tag[parser->tagLen++] = ch;
+                } else {
+                    /* Too long to be one of ours, make sure it isn't */
+                    parser->tag[0] = '#';
+                }
+                break;
+
+            case LX_TAG_REST:
+                if ( parser->quote != '\0' ) {
+                    if ( ch == parser->quote ) {
+                        parser->quote = '\0';
+                    }
+                } else if ( ch == '>' ) {
+                    TagDone( parser );
+                } else if ( ch == '/' ) {
+                    parser->empty = true;
+                } else if ( (ch == '"') || (ch == '\'') ) {
+                    parser->quote = ch;
+                    parser->empty = false;
+                } else if ( !XML_SPACE( ch ) ) {
+                    parser->empty = false;
+                }
+                break;
+
+            case LX_PI:
+                if ( (ch == '>') && (parser->match == 1) ) {
+                    parser->lex = LX_TEXT;
+                } else {
+                    parser->match = (ch == '?') ? 1 : 0;
+                }
+                break;
+
+            case LX_BANG:
+                if ( (parser->match == 0) && (ch == '-') ) {
+                    parser->match = 1;
+                } else if ( (parser->match == 1) && (ch == '-') ) {
+                    parser->lex = LX_COMMENT;
+                    parser->match = 0;
+                } else if ( (parser->tagLen < sizeof( gCDATAStart ) - 1) &&
+                            (parser->match == 0) &&
+                            (ch == gCDATAStart[parser->tagLen]) ) {
+                    parser->tagLen++;
+                    if ( parser->tagLen == sizeof( gCDATAStart ) - 1 ) {
+                        parser->lex = LX_CDATA;
+                        parser->match = 0;
+                    }
+                } else {
+                    parser->lex = (ch == '>') ? LX_TEXT : LX_DECL;
+                }
+                break;
+
+            case LX_COMMENT:
+                if ( ch == '-' ) {
+                    if ( parser->match < 2 ) {
+                        parser->match++;
+                    }
+                } else if ( (ch == '>') && (parser->match == 2) ) {
+                    parser->lex = LX_TEXT;
+                } else {
+                    parser->match = 0;
+                }
+                break;
+
+            case LX_CDATA:
+                if ( ch == ']' ) {
+                    if ( parser->match < 2 ) {
+                        parser->match++;
+                    } else {
+                        DecodeByte( parser, ch );
+                    }
+                } else if ( (ch == '>') && (parser->match == 2) ) {
+                    parser->lex = LX_TEXT;
+                } else {
+                    while ( parser->match > 0 ) {
+                        DecodeByte( parser, ']' );
+                        parser->match--;
+                    }
+                    DecodeByte( parser, ch );
+                }
+                break;
+
+            case LX_DECL:
+                if ( ch == '>' ) {
+                    parser->lex = LX_TEXT;
+                }
+                break;
+        }
+    }
+
+    return ( parser->status != PS_RUNNING );
+}
+
+
+/*
+ * Name:   XRParserEnd()
+ * Args:   parser - the parser, after the last of the response
+ * Return: 0 if the whole response was parsed or the event function
+ *         stopped it, -1 if it was cut short or wasn't XML-RPC
+ */
+
+int XRParserEnd( XRParser *parser )
+{
+    if ( (parser->status == PS_DONE) || (parser->status == PS_STOPPED) ) {
+        return 0;
+    }
+
+    return -1;
+}
+
+
+/*
+ * Name:   XRParserWatch()
+ * Args:   ctx - the XRParser
+ *         data, length - the next piece of the response body
+ * Return: true to stop reading the response
+ * Desc:   An HTTPWatchFunc, so a response is parsed as it comes in.
+ */
+
+Boolean XRParserWatch( void *ctx, char *data, UInt16 length )
+{
+    return XRParserFeed( (XRParser *)ctx, data, length );
+}
+
+
+/*
+ * Response trees.  Offsets are from 'base', which is where the tree starts
+ * in its arena, and the first few bytes are skipped so that no node is at
+ * XR_NO_NODE.  Offsets are 16 bits, so a tree can use up to 64k of an
+ * arena.  The two hash tables are open addressed with the offsets of names
+ * or member nodes in their slots, and double in size when they get half
+ * full, the old table is just left behind in the arena.
+ */
+
+#define TREE_LIMIT ((UInt32)0xFFFF)
+#define HASH_START (16)
+
+#define ALIGN_LONG( arena ) \
+    ((4 - ((UInt32)(unsigned long)((arena)->base + (arena)->used) & 3)) & 3)
+
+#define FOLD_CASE( ch ) \
+    ((((ch) >= 'A') && ((ch) <= 'Z')) ? ((ch) + ('a' - 'A')) : (ch))
+
+
+/*
+ * Name:   TreeAlloc()
+ * Args:   tree - the tree
+ *         size - bytes needed
+ * Return: offset of the memory, or 0 if there's no room (and 'failed' is
+ *         set)
+ */
+
+static UInt16 TreeAlloc( XRTree *tree, UInt32 size )
+{
+    char *block;
+
+    block = (char *)XRArenaAlloc( tree->arena, size );
+    if ( (block == NULL) || 
+            ((UInt32)(block - tree->base) + size > TREE_LIMIT) ) {
+        tree->failed = true;
+        return 0;
+    }
+
+    return (UInt16)(block - tree->base);
+}
+
+
+/*
+ * Name:   TreeSlots()
+ * Args:   tree - the tree
+ *         hash - one of its hash tables
+ * Return: the table's slots
+ */
+
+static UInt16 *TreeSlots( XRTree *tree, XRHash *hash )
+{
+    return (UInt16 *)(tree->base + hash->slots);
+}
+
+
+/*
+ * Name:   NameKey(), MemberKey()
+ * Desc:   Hash keys for a name (ignoring case) and for a member, which is
+ *         its struct and interned name together.
+ */
+
+static UInt16 NameKey( const char *name, UInt16 length )
+{
+    UInt16 key;
+    UInt16 i;
+
+    key = 0;
+    for ( i = 0; i < length; i++ ) {
+        key = (key * 31) + FOLD_CASE( name[i] );
+    }
+
+    return key;
+}
+
+static UInt16 MemberKey( XRNodeRef parent, UInt16 name )
+{
+    return (UInt16)((parent * 31) + (name * 7));
+}
+
+
+/*
+ * Name:   HashStart()
+ * Args:   tree - the tree
+ *         hash - table to set up
+ *         size - number of slots, a power of 2
+ * Return: 0 on success, -1 if there's no room
+ */
+
+static int HashStart( XRTree *tree, XRHash *hash, UInt16 size )
+{
+    hash->slots = TreeAlloc( tree, size * sizeof( UInt16 ) );
+    if ( hash->slots == 0 ) {
+        return -1;
+    }
+    hash->size = size;
+    hash->count = 0;
+    MemSet( TreeSlots( tree, hash ), size * sizeof( UInt16 ), 0 );
+
+    return 0;
+}
+
+
+/*
+ * Name:   HashPut()
+ * Args:   tree - the tree
+ *         hash - table to add to
+ *         key - hash key of the entry
+ *         entry - offset to store
+ * Return: 0 on success, -1 if there's no room
+ * Desc:   Keys for the entries already in the table are worked out again
+ *         from what they point at when it grows, which is why it needs to
+ *         know which table it is.
+ */
+
+static int HashPut( XRTree *tree, XRHash *hash, UInt16 key, UInt16 entry )
+{
+    XRHash grown;
+    UInt16 *slots;
+    UInt16 i;
+    UInt16 old;
+    XRNode *node;
+    const char *name;
+
+    if ( (UInt32)(hash->count + 1) * 2 > hash->size ) {
+        if ( HashStart( tree, &grown, hash->size * 2 ) != 0 ) {
+            return -1;
+        }
+        slots = TreeSlots( tree, hash );
+        for ( i = 0; i < hash->size; i++ ) {
+            old = slots[i];
+            if ( old == 0 ) {
+                continue;
+            }
+            if ( hash == &(tree->names) ) {
+                name = tree->base + old;
+                HashPut( tree, &grown, NameKey( name, StrLen( name ) ), old );
+            } else {
+                node = (XRNode *)(tree->base + old);
+                HashPut( tree, &grown, MemberKey( node->parent, node->name ),
+                         old );
+            }
+        }
+        *hash = grown;
+    }
+
+    slots = TreeSlots( tree, hash );
+    i = key & (hash->size - 1);
+    while ( slots[i] != 0 ) {
+        i = (i + 1) & (hash->size - 1);
+    }
+    slots[i] = entry;
+    hash->count++;
+
+    return 0;
+}
+
+
+/*
+ * Name:   FindName()
+ * Args:   tree - the tree
+ *         name, length - the name to look for
+ * Return: offset of the interned name, 0 if it hasn't been seen
+ */
+
+static UInt16 FindName( XRTree *tree, const char *name, UInt16 length )
+{
+    UInt16 *slots;
+    UInt16 i;
+    const char *interned;
+
+    slots = TreeSlots( tree, &(tree->names) );
+    i = NameKey( name, length ) & (tree->names.size - 1);
+    while ( slots[i] != 0 ) {
+        interned = tree->base + slots[i];
+        if ( (StrNCaselessCompare( interned, name, length ) == 0) &&
+                (interned[length] == '\0') ) {
+            return slots[i];
+        }
+        i = (i + 1) & (tree->names.size - 1);
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   InternName()
+ * Args:   tree - the tree
+ *         name, length - a member name from the response
+ * Return: offset of the interned name, 0 if there's no room
+ */
+
+static UInt16 InternName( XRTree *tree, const char *name, UInt16 length )
+{
+    UInt16 offset;
+
+    offset = FindName( tree, name, length );
+    if ( offset != 0 ) {
+        return offset;
+    }
+
+    offset = TreeAlloc( tree, length + 1 );
+    if ( offset == 0 ) {
+        return 0;
+    }
+    MemMove( tree->base + offset, name, length );
+    tree->base[offset + length] = '\0';
+
+    if ( HashPut( tree, &(tree->names), NameKey( name, length ), 
+                  offset ) != 0 ) {
+        return 0;
+    }
+
+    return offset;
+}
+
+
+/*
+ * Name:   XRTreeStart()
+ * Args:   tree - tree to set up
+ *         arena - where to put it, from its first free byte on
+ * Return: 0 on success, -1 if the arena doesn't have room to start one
+ */
+
+int XRTreeStart( XRTree *tree, XRArena *arena )
+{
+    XRNode *root;
+
+    MemSet( tree, sizeof( XRTree ), 0 );
+    tree->arena = arena;
+
+    /* Nodes have to be lined up, but the arena's memory may not be */
+    if ( (arena->base == NULL) || 
+            (ALIGN_LONG( arena ) > (arena->size - arena->used)) ) {
+        return -1;
+    }
+    arena->used += ALIGN_LONG( arena );
+    tree->base = arena->base + arena->used;
+
+    if ( (TreeAlloc( tree, sizeof( UInt32 ) ) != 0) ||
+            (HashStart( tree, &(tree->names), HASH_START ) != 0) ||
+            (HashStart( tree, &(tree->members), HASH_START ) != 0) ) {
+        return -1;
+    }
+
+    tree->root = TreeAlloc( tree, sizeof( XRNode ) );
+    if ( tree->root == XR_NO_NODE ) {
+        return -1;
+    }
+    root = XRTreeNode( tree, tree->root );
+    MemSet( root, sizeof( XRNode ), 0 );
+    root->type = XRN_ARRAY;
+    tree->open[0] = tree->root;
+
+    return 0;
+}
+
+
+/*
+ * Name:   AddNode()
+ * Args:   tree - the tree
+ *         depth - depth of the event the node is for
+ *         type - XRT_ or XRN_ type of the node
+ * Return: the new node, XR_NO_NODE if there's no room
+ * Desc:   The node goes on the end of the struct or array open at 'depth',
+ *         named with the last member name if it's a struct.
+ */
+
+static XRNodeRef AddNode( XRTree *tree, UInt8 depth, UInt8 type )
+{
+    XRNodeRef ref;
+    XRNode *node;
+    XRNode *parent;
+
+    ref = TreeAlloc( tree, sizeof( XRNode ) );
+    if ( ref == XR_NO_NODE ) {
+        return XR_NO_NODE;
+    }
+
+    node = XRTreeNode( tree, ref );
+    MemSet( node, sizeof( XRNode ), 0 );
+    node->type = type;
+    node->parent = tree->open[depth];
+
+    parent = XRTreeNode( tree, node->parent );
+    if ( tree->last[depth] == XR_NO_NODE ) {
+        parent->value = ref;
+    } else {
+        XRTreeNode( tree, tree->last[depth] )->next = ref;
+    }
+    tree->last[depth] = ref;
+    parent->length++;
+
+    if ( (parent->type == XRN_STRUCT) && (tree->member != 0) ) {
+        node->name = tree->member;
+        if ( HashPut( tree, &(tree->members), 
+                      MemberKey( node->parent, node->name ), ref ) != 0 ) {
+            return XR_NO_NODE;
+        }
+    }
+    tree->member = 0;
+
+    return ref;
+}
+
+
+/*
+ * Name:   TreeText()
+ * Args:   tree - the tree
+ *         event - a value, or the next piece of one
+ * Return: 0 on success, -1 if there's no room
+ * Desc:   The pieces of a value come one straight after another with
+ *         nothing else allocated in between, so the text is put straight
+ *         on the end of the arena without rounding and the value's text
+ *         stays in one piece.  The arena is lined up again once the last
+ *         piece is in.
+ */
+
+static int TreeText( XRTree *tree, XREvent *event )
+{
+    XRArena *arena;
+    XRNode *node;
+
+    arena = tree->arena;
+    if ( tree->text == XR_NO_NODE ) {
+        tree->text = AddNode( tree, event->depth, event->type );
+        if ( tree->text == XR_NO_NODE ) {
+            return -1;
+        }
+        XRTreeNode( tree, tree->text )->value = 
+            (UInt16)((arena->base + arena->used) - tree->base);
+    }
+
+    if ( ((UInt32)event->length + 1 > (arena->size - arena->used)) ||
+            ((UInt32)((arena->base + arena->used) - tree->base) + 
+             event->length + 1 > TREE_LIMIT) ) {
+        tree->failed = true;
+        return -1;
+    }
+
+    node = XRTreeNode( tree, tree->text );
+    MemMove( arena->base + arena->used, event->text, event->length );
+    arena->used += event->length;
+    node->length += event->length;
+
+    if ( !event->partial ) {
+        EndText( tree );
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   EndText()
+ * Args:   tree - the tree
+ * Return: none
+ * Desc:   Ends the string being added to, and lines the arena up again for
+ *         the next node.  TreeText() always leaves room for the '\0'.
+ */
+
+static void EndText( XRTree *tree )
+{
+    XRArena *arena;
+
+    arena = tree->arena;
+    arena->base[arena->used++] = '\0';
+    if ( ALIGN_LONG( arena ) <= (arena->size - arena->used) ) {
+        arena->used += ALIGN_LONG( arena );
+    } else {
+        arena->used = arena->size;
+    }
+    tree->text = XR_NO_NODE;
+}
+
+
+/*
+ * Name:   XRTreeEvent()
+ * Args:   ctx - the XRTree
+ *         event - next part of the response
+ * Return: true to stop the parse, when the tree can't be added to
+ * Desc:   An XREventFunc that adds each event to the tree.
+ */
+
+Boolean XRTreeEvent( void *ctx, XREvent *event )
+{
+    XRTree *tree;
+    XRNodeRef ref;
+
+    tree = (XRTree *)ctx;
+    /* Structs inside a fault never reach here, so junk after one can
+     * arrive at a depth with nothing open */
+    if ( (event->depth >= XR_TREE_DEPTH) || 
+            (tree->open[event->depth] == XR_NO_NODE) ) {
+        tree->failed = true;
+        return true;
+    }
+
+    /* A broken response can leave a value's pieces unfinished */
+    if ( (event->kind != XRE_VALUE) && (tree->text != XR_NO_NODE) ) {
+        EndText( tree );
+    }
+
+    switch ( event->kind ) {
+        case XRE_VALUE:
+            if ( TreeText( tree, event ) != 0 ) {
+                return true;
+            }
+            break;
+
+        case XRE_MEMBER:
+            tree->member = InternName( tree, event->text, event->length );
+            if ( tree->failed ) {
+                return true;
+            }
+            break;
+
+        case XRE_STRUCT_BEGIN:
+        case XRE_ARRAY_BEGIN:
+            if ( event->depth + 1 >= XR_TREE_DEPTH ) {
+                tree->failed = true;
+                return true;
+            }
+            ref = AddNode( tree, event->depth, 
+                           (event->kind == XRE_STRUCT_BEGIN) ? 
+                           XRN_STRUCT : XRN_ARRAY );
+            if ( ref == XR_NO_NODE ) {
+                return true;
+            }
+            tree->open[event->depth + 1] = ref;
+            tree->last[event->depth + 1] = XR_NO_NODE;
+            break;
+
+        default:
+            break;
+    }
+
+    return false;
+}
+
+
+/*
+ * Name:   XRTreeNode()
+ * Args:   tree - the tree
+ *         ref - one of its nodes
+ * Return: the node, or NULL for XR_NO_NODE
+ */
+
+XRNode *XRTreeNode( XRTree *tree, XRNodeRef ref )
+{
+    if ( ref == XR_NO_NODE ) {
+        return NULL;
+    }
+
+    return (XRNode *)(tree->base + ref);
+}
+
+
+/*
+ * Name:   XRTreeFirst(), XRTreeNext()
+ * Args:   tree - the tree
+ *         ref - a struct or array, or one of their members or elements
+ * Return: the first thing in the struct or array, or the one after 'ref'
+ *         in its parent, XR_NO_NODE if there isn't one
+ * Desc:   Either can be passed XR_NO_NODE, which they just give back.
+ */
+
+XRNodeRef XRTreeFirst( XRTree *tree, XRNodeRef ref )
+{
+    XRNode *node;
+
+    node = XRTreeNode( tree, ref );
+    if ( (node == NULL) || 
+            ((node->type != XRN_STRUCT) && (node->type != XRN_ARRAY)) ) {
+        return XR_NO_NODE;
+    }
+
+    return node->value;
+}
+
+XRNodeRef XRTreeNext( XRTree *tree, XRNodeRef ref )
+{
+    XRNode *node;
+
+    node = XRTreeNode( tree, ref );
+    if ( node == NULL ) {
+        return XR_NO_NODE;
+    }
+
+    return node->next;
+}
+
+
+/*
+ * Name:   XRTreeMember()
+ * Args:   tree - the tree
+ *         ref - a struct
+ *         name - the member wanted
+ * Return: the member's value, XR_NO_NODE if the struct doesn't have one
+ *         by that name
+ */
+
+XRNodeRef XRTreeMember( XRTree *tree, XRNodeRef ref, const char *name )
+{
+    UInt16 interned;
+    UInt16 *slots;
+    UInt16 i;
+    XRNode *node;
+
+    if ( ref == XR_NO_NODE ) {
+        return XR_NO_NODE;
+    }
+
+    interned = FindName( tree, name, StrLen( name ) );
+    if ( interned == 0 ) {
+        return XR_NO_NODE;
+    }
+
+    slots = TreeSlots( tree, &(tree->members) );
+    i = MemberKey( ref, interned ) & (tree->members.size - 1);
+    while ( slots[i] != 0 ) {
+        node = XRTreeNode( tree, slots[i] );
+        if ( (node->parent == ref) && (node->name == interned) ) {
+            return slots[i];
+        }
+        i = (i + 1) & (tree->members.size - 1);
+    }
+
+    return XR_NO_NODE;
+}
+
+
+/*
+ * Name:   XRTreeText()
+ * Args:   tree - the tree
+ *         ref - a node
+ * Return: the text of a scalar.  Gives an empty string when there's
+ *         nothing to give, including for XR_NO_NODE, so lookups can be
+ *         passed straight in.
+ */
+
+const char *XRTreeText( XRTree *tree, XRNodeRef ref )
+{
+    XRNode *node;
+
+    node = XRTreeNode( tree, ref );
+    if ( (node == NULL) || (node->type == XRN_STRUCT) || 
+            (node->type == XRN_ARRAY) ) {
+        return "";
+    }
+
+    return tree->base + node->value;
+}
+
+
+/*
+ * Name:   XRArenaStart()
+ * Args:   arena - arena to set up
+ *         size - total number of bytes it can hand out
+ * Return: 0 on success, -1 if the memory isn't available
+ */
+
+int XRArenaStart( XRArena *arena, UInt32 size )
+{
+    arena->used = 0;
+    arena->size = XR_ARENA_SIZE( size );
+    arena->base = (char *)MemPtrNew( arena->size );
+    if ( arena->base == NULL ) {
+        arena->size = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Name:   XRArenaAlloc()
+ * Args:   arena - arena to allocate from
+ *         size - number of bytes needed
+ * Return: pointer to the memory, or NULL if the arena is out of room
+ * Desc:   The size is rounded with XR_ARENA_SIZE() so that every allocation
+ *         starts on a long boundary.
+ */
+
+void *XRArenaAlloc( XRArena *arena, UInt32 size )
+{
+    void *block;
+
+    size = XR_ARENA_SIZE( size );
+    if ( (arena->base == NULL) || (size > (arena->size - arena->used)) ) {
+        return NULL;
+    }
+
+    block = arena->base + arena->used;
+    arena->used += size;
+    return block;
+}
+
+
+/*
+ * Name:   XRArenaReset()
+ * Args:   arena - arena to empty
+ * Return: none
+ * Desc:   Everything allocated so far is given back in one go, the memory
+ *         itself is kept for reuse.
+ */
+
+void XRArenaReset( XRArena *arena )
+{
+    arena->used = 0;
+}
+
+
+/*
+ * Name:   XRArenaEnd()
+ * Args:   arena - arena to release
+ * Return: none
+ * Desc:   Frees the arena's memory.  Safe to call on an arena that failed
+ *         to start or has already been ended.
+ */
+
+void XRArenaEnd( XRArena *arena )
+{
+    if ( arena->base != NULL ) {
+        MemPtrFree( arena->base );
+        arena->base = NULL;
+    }
+    arena->size = 0;
+    arena->used = 0;
+}
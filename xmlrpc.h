@@ -0,0 +1,408 @@
+/* arch-tag: XML-RPC request encoding header file for vagablog
+ *
+ * Vagablog - Palm based Blog utility
+ *
+ * Copyright (C) 2003,2004,2005 Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is PalmHTTP.
+ *
+ * The Initial Developer of the Original Code is
+ * Mike Rowehl <miker@bitsplitter.net>
+ * Portions created by the Initial Developer are Copyright (C) 2003
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Mike Rowehl <miker@bitsplitter.net>
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#if !defined(XMLRPC_H_)
+#define XMLRPC_H_ 1
+
+#include <PalmOS.h>
+
+#include "http.h"
+
+
+/*
+ * Requests are put together with a builder, one typed value at a time, in a
+ * function that's handed the builder to write into.  The same function is
+ * run twice: once into a builder that only counts, which gives the exact
+ * Content-Length, and then again to send the request.  Nothing is formatted
+ * into memory on the way: text is escaped as it goes out, so the only copy
+ * of a post body is the one in its field.  A builder can also write into a
+ * fixed size buffer, for when the request is wanted as a string.
+ *
+ * Top level values are the params of the call.  Inside a struct each value
+ * has to be named with XRMember() first.  String values can be written in
+ * one go with XRString() or in pieces between XRStringBegin() and
+ * XRStringEnd().  Text with 'escape' set is user text and gets XML escaped,
+ * the rest (the cached credentials, markup we build ourselves) is sent
+ * exactly as given.
+ */
+
+#define XRB_COUNT (0)
+#define XRB_WINDOW (1)
+#define XRB_BUFFER (2)
+
+#define XRB_MAX_DEPTH (16)
+
+typedef struct XRBuilder_struct {
+    UInt8 sink;
+    HTTPWindow *window;
+    char *buffer;
+    UInt32 size;
+    UInt32 length;
+    UInt8 depth;
+    UInt16 structs;
+} XRBuilder;
+
+typedef void (*XRBuildFunc)( XRBuilder *builder, void *ctx );
+
+typedef struct XRBuild_struct {
+    XRBuildFunc build;
+    void *ctx;
+} XRBuild;
+
+#define XRRawLiteral( builder, literal ) \
+    XRRaw( builder, literal, sizeof( literal ) - 1 )
+
+
+/*
+ * The types of scalar values, both in params and as they come out of a
+ * parsed response.  A call's result, or a fault, is reported in an
+ * XRResult.  Its text is decoded the same way as parser events (see
+ * below).
+ */
+
+#define XRT_STRING (0)
+#define XRT_BOOLEAN (1)
+#define XRT_INT (2)
+#define XRT_DOUBLE (3)
+#define XRT_DATETIME (4)
+#define XRT_BASE64 (5)
+#define XRT_NIL (6)
+
+#define XR_RESULT_LEN (256)
+
+typedef struct XRResult_struct {
+    Boolean fault;
+    Int32 faultCode;
+    char text[XR_RESULT_LEN];
+} XRResult;
+
+
+/*
+ * Responses are parsed as they arrive, a fragment at a time, by an XRParser
+ * handed to HTTPPostBody() as its watcher (XRParserWatch()).  It can also
+ * be fed directly with XRParserFeed().  All of its state is in the struct,
+ * so a response of any size parses in the same small fixed space.  The
+ * structure of the response comes out as events:
+ *
+ *   XRE_VALUE          a scalar, 'type' is one of the XRT_ values
+ *   XRE_MEMBER         the name of the struct member whose value is next
+ *   XRE_STRUCT_BEGIN   ... and _END, around the members of a struct
+ *   XRE_ARRAY_BEGIN    ... and _END, around the elements of an array
+ *   XRE_DONE           the end of the response
+ *
+ * 'depth' is how many structs and arrays the event is inside, so the
+ * params themselves are at depth 0.  'text' is only good for the length of
+ * the call.  A string longer than XR_TEXT_LEN comes out in pieces, all but
+ * the last with 'partial' set.  Text is decoded as it's kept: entities and
+ * character references are replaced, and UTF-8 is turned into the Palm
+ * character set.  Bytes that aren't valid UTF-8 are taken to already be
+ * Palm (Latin-1) characters, and anything Palm has no character for comes
+ * out as XR_FALLBACK_CHAR.
+ * Returning true from the event function stops the parse, which stops
+ * the read when it's the HTTP watcher.
+ *
+ * A fault is picked out by the parser itself and doesn't come out as
+ * events: the XRResult given to XRParserStart() gets 'fault' set and the
+ * fault code and string.
+ *
+ * The parser itself allocates nothing.
+ */
+
+#define XRE_VALUE (0)
+#define XRE_MEMBER (1)
+#define XRE_STRUCT_BEGIN (2)
+#define XRE_STRUCT_END (3)
+#define XRE_ARRAY_BEGIN (4)
+#define XRE_ARRAY_END (5)
+#define XRE_DONE (6)
+
+typedef struct XREvent_struct {
+    UInt8 kind;
+    UInt8 type;
+    UInt8 depth;
+    Boolean partial;
+    char *text;
+    UInt16 length;
+} XREvent;
+
+typedef Boolean (*XREventFunc)( void *ctx, XREvent *event );
+
+#define XR_TAG_LEN (20)
+#define XR_TEXT_LEN (128)
+#define XR_ENTITY_LEN (12)
+#define XR_FALLBACK_CHAR ('?')
+
+typedef struct XRParser_struct {
+    UInt8 lex;
+    UInt8 match;
+    char quote;
+    Boolean closing;
+    Boolean empty;
+    UInt8 tagLen;
+    char tag[XR_TAG_LEN];
+    UInt8 collect;
+    UInt8 type;
+    Boolean valueDone;
+    Boolean partialSent;
+    UInt8 depth;
+    Boolean inFault;
+    UInt8 faultMember;
+    UInt8 status;
+    UInt16 faultLen;
+    XREventFunc func;
+    void *ctx;
+    XRResult *fault;
+    UInt8 entityLen;
+    char entity[XR_ENTITY_LEN];
+    UInt8 seqLen;
+    UInt8 seqNeed;
+    char seq[4];
+    UInt16 textLen;
+    char text[XR_TEXT_LEN];
+} XRParser;
+
+
+/*
+ * A block of memory that things only needed for one request or response
+ * (like an XRTree) are carved out of.  Allocating just moves 'used' along
+ * and nothing is freed on its own, the whole block goes at once.
+ * XR_ARENA_SIZE() rounds a size up the same way allocations are, so an
+ * arena can be sized exactly up front.
+ */
+
+typedef struct XRArena_struct {
+    char *base;
+    UInt32 size;
+    UInt32 used;
+} XRArena;
+
+#define XR_ARENA_SIZE( size ) (((UInt32)(size) + 3) & ~(UInt32)3)
+
+
+/*
+ * For responses that are easier to pick through as a whole than as they go
+ * by, XRTreeEvent() can be given to XRParserStart() to build the response
+ * as a tree.  The tree is allocated from an XRArena and refers to its
+ * nodes by offset (XRNodeRef, XR_NO_NODE for none), so it's compact and
+ * doesn't care where the arena's memory is.  'root' is an array holding
+ * the params.  A node's 'value' is the offset of its text for a scalar,
+ * which is decoded and '\0' terminated, or its first child for a struct or
+ * array.  'length' is the length of the text or the number of children.
+ *
+ * Member names are interned, so each is stored once however many structs
+ * use it, and XRTreeMember() finds a member through a hash table rather
+ * than by walking the struct.  Names are matched ignoring case, since
+ * servers don't agree on it.  If the arena runs out of room, or values nest
+ * deeper than XR_TREE_DEPTH, the parse is stopped and 'failed' is set.
+ */
+
+#define XRN_STRUCT (7)
+#define XRN_ARRAY (8)
+
+#define XR_NO_NODE (0)
+#define XR_TREE_DEPTH (16)
+
+typedef UInt16 XRNodeRef;
+
+typedef struct XRNode_struct {
+    UInt8 type;
+    UInt8 unused;
+    XRNodeRef parent;
+    XRNodeRef next;
+    UInt16 name;
+    UInt16 value;
+    UInt16 length;
+} XRNode;
+
+typedef struct XRHash_struct {
+    UInt16 slots;
+    UInt16 size;
+    UInt16 count;
+} XRHash;
+
+typedef struct XRTree_struct {
+    XRArena *arena;
+    char *base;
+    Boolean failed;
+    XRNodeRef root;
+    XRNodeRef open[XR_TREE_DEPTH];
+    XRNodeRef last[XR_TREE_DEPTH];
+    UInt16 member;
+    XRNodeRef text;
+    XRHash names;
+    XRHash members;
+} XRTree;
+
+
+/*
+ * Calls can also be described as data, which lets several of them be
+ * packed into one system.multicall request.  A call is a method name and a
+ * list of typed params given as text, followed by whatever 'build' writes
+ * (if it isn't NULL) for params that aren't scalars, like a post struct.
+ * 'text' is sent as it is for every type, so a DATETIME has to be in ISO
+ * 8601 form already and BASE64 already encoded.  NIL doesn't use it.
+ *
+ * Each call gets its own result: the text of the scalar value the server
+ * sent back (empty for structs and arrays), or the fault code and string
+ * if that call failed.  'value' is the whole value in the batch's tree, or
+ * XR_NO_NODE if the call faulted or was never answered.
+ *
+ * A batch is a set of calls to make against the same server.  If the
+ * server supports system.multicall they all go in one round trip,
+ * otherwise they're made one after the other.  Whether it does is found
+ * out with system.listMethods the first time and remembered in the
+ * variable 'multicall' points to, so the caller can keep one per server
+ * and reset it to XR_MULTICALL_UNKNOWN when the server settings change.
+ * The responses go into 'tree', in the buffer given to XRBatchRun(), and
+ * can be picked through until the buffer is reused.
+ */
+
+typedef struct XRParam_struct {
+    UInt8 type;
+    Boolean escape;
+    const char *text;
+} XRParam;
+
+typedef struct XRCall_struct {
+    const char *method;
+    const XRParam *params;
+    UInt16 paramCount;
+    XRBuildFunc build;
+    void *ctx;
+    XRResult result;
+    XRNodeRef value;
+} XRCall;
+
+#define XR_MULTICALL_UNKNOWN (0)
+#define XR_MULTICALL_YES (1)
+#define XR_MULTICALL_NO (2)
+
+typedef struct XRBatch_struct {
+    XRCall *calls;
+    UInt16 callCount;
+    UInt8 *multicall;
+    XRTree tree;
+} XRBatch;
+
+
+/*
+ * Media uploads (metaWeblog.newMediaObject) carry the file as base64, which
+ * is encoded a small window at a time while the request goes out, so the
+ * file is never in memory.  It's read from an XRSource, which is either a
+ * stream DB or a file on a VFS volume.  The size is found when the source
+ * is opened so the Content-Length can be worked out before anything is
+ * sent.  'name' and 'pass' are the already escaped credentials, 'blogID'
+ * and 'fileName' are escaped on the way out.  XRMediaBody() fills in
+ * 'build', everything in the XRMedia has to stay put until the post is
+ * done.
+ */
+
+#define XRS_STREAM (0)
+#define XRS_VFS (1)
+
+typedef struct XRSource_struct {
+    UInt8 kind;
+    UInt32 size;
+    FileHand stream;
+    FileRef file;
+} XRSource;
+
+#define XR_BASE64_LENGTH( size ) ((((UInt32)(size) + 2) / 3) * 4)
+
+typedef struct XRMedia_struct {
+    const char *blogID;
+    const char *name;
+    const char *pass;
+    const char *fileName;
+    const char *mimeType;
+    XRSource *source;
+    XRBuild build;
+} XRMedia;
+
+
+/*
+ * Longest escape for a single character, and a buffer size that's always
+ * enough to hold 'length' characters once escaped.
+ */
+
+#define XR_ESCAPE_MAX (6)
+#define XR_ESCAPED_SIZE( length ) (((UInt32)(length) * XR_ESCAPE_MAX) + 1)
+
+
+Int32 XREscapeBounded( const char *text, char *out, UInt32 outSize );
+void XRBuilderCount( XRBuilder *builder );
+void XRBuilderWindow( XRBuilder *builder, HTTPWindow *window );
+void XRBuilderBuffer( XRBuilder *builder, char *buffer, UInt32 size );
+Int32 XRBuilderEnd( XRBuilder *builder );
+void XRRaw( XRBuilder *builder, const char *text, UInt32 length );
+void XRText( XRBuilder *builder, const char *text, Boolean escape );
+void XRCallBegin( XRBuilder *builder, const char *method );
+void XRCallEnd( XRBuilder *builder );
+void XRString( XRBuilder *builder, const char *text, Boolean escape );
+void XRStringBegin( XRBuilder *builder );
+void XRStringEnd( XRBuilder *builder );
+void XRInt( XRBuilder *builder, Int32 value );
+void XRBoolean( XRBuilder *builder, Boolean value );
+void XRDateTime( XRBuilder *builder, const DateTimeType *when );
+void XRBase64( XRBuilder *builder, XRSource *source );
+void XRStructBegin( XRBuilder *builder );
+void XRMember( XRBuilder *builder, const char *name );
+void XRStructEnd( XRBuilder *builder );
+void XRArrayBegin( XRBuilder *builder );
+void XRArrayEnd( XRBuilder *builder );
+void XRBuildBody( XRBuild *build, HTTPBody *body );
+Int32 XRBuildString( XRBuild *build, char *buffer, UInt32 size );
+int XRArenaStart( XRArena *arena, UInt32 size );
+void *XRArenaAlloc( XRArena *arena, UInt32 size );
+void XRArenaReset( XRArena *arena );
+void XRArenaEnd( XRArena *arena );
+int XRSourceOpenStream( XRSource *source, const char *name );
+int XRSourceOpenVFS( XRSource *source, UInt16 volRef, const char *path );
+void XRSourceClose( XRSource *source );
+void XRMediaBody( XRMedia *media, HTTPBody *body );
+void XRParserStart( XRParser *parser, XREventFunc func, void *ctx,
+                    XRResult *fault );
+Boolean XRParserFeed( XRParser *parser, const char *data, UInt32 length );
+int XRParserEnd( XRParser *parser );
+Boolean XRParserWatch( void *ctx, char *data, UInt16 length );
+int XRTreeStart( XRTree *tree, XRArena *arena );
+Boolean XRTreeEvent( void *ctx, XREvent *event );
+XRNode *XRTreeNode( XRTree *tree, XRNodeRef ref );
+XRNodeRef XRTreeFirst( XRTree *tree, XRNodeRef ref );
+XRNodeRef XRTreeNext( XRTree *tree, XRNodeRef ref );
+XRNodeRef XRTreeMember( XRTree *tree, XRNodeRef ref, const char *name );
+const char *XRTreeText( XRTree *tree, XRNodeRef ref );
+int XRBatchRun( URLTarget *url, XRBatch *batch, char *buffer,
+                UInt32 bufferSize );
+
+
+#endif /* XMLRPC_H_ */